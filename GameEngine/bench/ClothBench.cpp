@@ -0,0 +1,85 @@
+// Headless cloth benchmark: SpawnClothDrape at a given resolution, stepped at a fixed rate.
+//
+//   cloth_bench [--resolution N] [--steps N] [--workers N] [--substeps N]
+#include "JobSystem.h"
+#include "Log.h"
+#include "SoftBody.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static double Seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv) {
+    int resolution = 256, steps = 300, workers = -1, substeps = 8;
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--resolution") == 0 && hasValue) {
+            resolution = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--steps") == 0 && hasValue) {
+            steps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && hasValue) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--substeps") == 0 && hasValue) {
+            substeps = atoi(argv[++i]);
+        } else {
+            LOG_ERROR("Unknown option: {}", argv[i]);
+            return 1;
+        }
+    }
+    if (resolution < 2 || steps < 1 || substeps < 1) {
+        LOG_ERROR("--resolution must be at least 2, --steps and --substeps positive");
+        return 1;
+    }
+
+    JobSystem jobs;
+    if (!jobs.Start(workers)) return 1;
+    SoftBodyConfig config;
+    config.substeps = substeps;
+    SoftBodyWorld world(config);
+    world.SetJobSystem(&jobs);
+    SpawnClothDrape(world, static_cast<uint32_t>(resolution));
+
+    const Real dt = Real(1) / Real(60);
+    std::vector<double> stepTimes;
+    double integrate = 0.0, solve = 0.0, collide = 0.0;
+    for (int i = 0; i < steps; ++i) {
+        double start = Seconds();
+        world.Step(dt);
+        stepTimes.push_back(Seconds() - start);
+        const SoftBodyStats &stats = world.GetStats();
+        integrate += stats.integrateTime, solve += stats.solveTime, collide += stats.collideTime;
+    }
+
+    // Settled state: how low the sheet sank and how far its edges stretched beyond rest
+    Real lowest = REAL_HUGE, maxStretch = Real(0);
+    const uint32_t n = static_cast<uint32_t>(resolution);
+    const Real spacing = Real(20) / Real(resolution - 1);
+    for (uint32_t i = 0; i < world.ParticleCount(); ++i) {
+        lowest = Min(lowest, world.GetPosition(i).y);
+        if ((i + 1) % n != 0)
+            maxStretch = Max(maxStretch, Length(world.GetPosition(i + 1) - world.GetPosition(i)) / spacing);
+    }
+
+    std::sort(stepTimes.begin(), stepTimes.end());
+    double total = 0.0;
+    for (double t : stepTimes) total += t;
+    const SoftBodyStats &stats = world.GetStats();
+    printf("cloth %dx%d: %u particles, %u constraints, %u colors, %d substeps, %d workers\n", resolution, resolution,
+           stats.particles, stats.constraints, stats.colors, substeps, jobs.WorkerCount());
+    printf("step ms: mean %.3f  median %.3f  p99 %.3f  max %.3f\n", total / steps * 1e3,
+           stepTimes[stepTimes.size() / 2] * 1e3, stepTimes[stepTimes.size() * 99 / 100] * 1e3,
+           stepTimes.back() * 1e3);
+    printf("per step ms: integrate %.3f  solve %.3f  collide %.3f\n", integrate / steps * 1e3, solve / steps * 1e3,
+           collide / steps * 1e3);
+    printf("lowest particle %.4f m, longest edge %.3f x rest\n", static_cast<double>(lowest),
+           static_cast<double>(maxStretch));
+    jobs.Stop();
+    return 0;
+}
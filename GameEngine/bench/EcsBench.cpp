@@ -0,0 +1,121 @@
+// Headless entity benchmark: integrate position += velocity * dt over entities with two components,
+// through the EntityWorld query and through two plain arrays as the memory bandwidth reference.
+// Every other entity also carries a 64 byte component the query must not touch.
+//
+//   ecs_bench [--entities N] [--steps N]
+#include "Log.h"
+#include "Object.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct Position {
+    float x, y, z;
+};
+struct Velocity {
+    float x, y, z;
+};
+struct Payload {
+    float data[16];
+};
+
+static double Seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Fastest of steps runs of pass, in seconds
+template <typename F> static double Best(int steps, const F &pass) {
+    double best = 1e30;
+    for (int i = 0; i < steps; ++i) {
+        double start = Seconds();
+        pass();
+        best = std::min(best, Seconds() - start);
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    int entities = 1000000, steps = 50;
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--entities") == 0 && hasValue) {
+            entities = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--steps") == 0 && hasValue) {
+            steps = atoi(argv[++i]);
+        } else {
+            LOG_ERROR("Unknown option: {}", argv[i]);
+            return 1;
+        }
+    }
+    if (entities < 1 || steps < 1) {
+        LOG_ERROR("--entities and --steps must be positive");
+        return 1;
+    }
+
+    const float dt = 1.0f / 60.0f;
+    EntityWorld world;
+    std::vector<Position> positions(entities);
+    std::vector<Velocity> velocities(entities);
+    double start = Seconds();
+    for (int i = 0; i < entities; ++i) {
+        Position p{float(i % 1000), 0.0f, float(i / 1000)};
+        Velocity v{0.0f, 1.0f + float(i % 7), 0.0f};
+        if (i % 2) {
+            world.Create(p, v, Payload{});
+        } else {
+            world.Create(p, v);
+        }
+        positions[i] = p;
+        velocities[i] = v;
+    }
+    double createTime = Seconds() - start;
+
+    double query = Best(steps, [&] {
+        world.ForEachChunk<Position, Velocity>([&](uint32_t count, const Entity *, Position *p, Velocity *v) {
+            for (uint32_t i = 0; i < count; ++i) {
+                p[i].x += v[i].x * dt;
+                p[i].y += v[i].y * dt;
+                p[i].z += v[i].z * dt;
+            }
+        });
+    });
+    double each = Best(steps, [&] {
+        world.Each<Position, Velocity>([&](Position &p, const Velocity &v) {
+            p.x += v.x * dt;
+            p.y += v.y * dt;
+            p.z += v.z * dt;
+        });
+    });
+    double arrays = Best(steps, [&] {
+        Position *p = positions.data();
+        const Velocity *v = velocities.data();
+        for (int i = 0; i < entities; ++i) {
+            p[i].x += v[i].x * dt;
+            p[i].y += v[i].y * dt;
+            p[i].z += v[i].z * dt;
+        }
+    });
+
+    // Heights start at zero and the world ran two passes for every one over the arrays
+    double height = 0.0, reference = 0.0;
+    world.Each<Position>([&](Position &p) { height += p.y; });
+    for (const Position &p : positions) reference += 2.0 * p.y;
+
+    // Position is read and written, velocity read
+    const double bytes = double(entities) * (2 * sizeof(Position) + sizeof(Velocity));
+    printf("ecs: %d entities, %zu archetypes, %zu chunks, created in %.1f ms\n", entities, world.ArchetypeCount(),
+           world.ChunkCount(), createTime * 1e3);
+    printf("chunk query ms %.3f (%.1f GB/s)\n", query * 1e3, bytes / query * 1e-9);
+    printf("each query ms  %.3f (%.1f GB/s)\n", each * 1e3, bytes / each * 1e-9);
+    printf("plain arrays ms %.3f (%.1f GB/s)\n", arrays * 1e3, bytes / arrays * 1e-9);
+    if (std::abs(height - reference) > 1e-6 * std::abs(reference)) {
+        LOG_ERROR("Query and reference disagree: {} vs {}", height, reference);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+// Headless fluid benchmark: SpawnDamBreak with a given particle count, stepped at a fixed rate.
+//
+//   fluid_bench [--particles N] [--steps N] [--workers N] [--substeps N]
+#include "Fluid.h"
+#include "JobSystem.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static double Seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv) {
+    int particles = 100000, steps = 120, workers = -1, substeps = 8;
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--particles") == 0 && hasValue) {
+            particles = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--steps") == 0 && hasValue) {
+            steps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && hasValue) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--substeps") == 0 && hasValue) {
+            substeps = atoi(argv[++i]);
+        } else {
+            LOG_ERROR("Unknown option: {}", argv[i]);
+            return 1;
+        }
+    }
+    if (particles < 1 || steps < 1 || substeps < 1) {
+        LOG_ERROR("--particles, --steps and --substeps must be positive");
+        return 1;
+    }
+
+    JobSystem jobs;
+    if (!jobs.Start(workers)) return 1;
+    FluidConfig config;
+    config.substeps = substeps;
+    FluidWorld world(config);
+    world.SetJobSystem(&jobs);
+    SpawnDamBreak(world, static_cast<uint32_t>(particles));
+
+    const Real dt = Real(1) / Real(60);
+    std::vector<double> stepTimes;
+    double sort = 0.0, density = 0.0, force = 0.0, integrate = 0.0, neighbors = 0.0;
+    for (int i = 0; i < steps; ++i) {
+        double start = Seconds();
+        world.Step(dt);
+        stepTimes.push_back(Seconds() - start);
+        const FluidStats &stats = world.GetStats();
+        sort += stats.sortTime, density += stats.densityTime, force += stats.forceTime;
+        integrate += stats.integrateTime;
+        neighbors += static_cast<double>(stats.averageNeighbors);
+    }
+
+    // Where the water went and how compressed it is
+    Real meanHeight = Real(0), maxDensity = Real(0);
+    for (uint32_t i = 0; i < world.ParticleCount(); ++i) {
+        meanHeight += world.GetPosition(i).y;
+        maxDensity = Max(maxDensity, world.GetDensity(i));
+    }
+    meanHeight = meanHeight / Real(static_cast<int>(world.ParticleCount()));
+
+    std::sort(stepTimes.begin(), stepTimes.end());
+    double total = 0.0;
+    for (double t : stepTimes) total += t;
+    const FluidStats &stats = world.GetStats();
+    printf("fluid: %u particles, %u cells, %.1f neighbors, %d substeps, %d workers\n", stats.particles, stats.cells,
+           neighbors / steps, substeps, jobs.WorkerCount());
+    printf("step ms: mean %.3f  median %.3f  p99 %.3f  max %.3f\n", total / steps * 1e3,
+           stepTimes[stepTimes.size() / 2] * 1e3, stepTimes[stepTimes.size() * 99 / 100] * 1e3,
+           stepTimes.back() * 1e3);
+    printf("substep ms: mean %.3f\n", total / steps / substeps * 1e3);
+    printf("per step ms: sort %.3f  density %.3f  force %.3f  integrate %.3f\n", sort / steps * 1e3,
+           density / steps * 1e3, force / steps * 1e3, integrate / steps * 1e3);
+    printf("mean height %.3f m, max density %.1f\n", static_cast<double>(meanHeight), static_cast<double>(maxDensity));
+    jobs.Stop();
+    return 0;
+}
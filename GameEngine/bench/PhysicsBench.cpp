@@ -0,0 +1,349 @@
+// Headless rigid body benchmark: standard scenes stepped at 60 Hz, results as JSON.
+//
+//   physics_bench [--scene NAME] [--steps N] [--workers N] [--output PATH]
+//                 [--baseline PATH] [--tolerance FRACTION]
+//
+// With --baseline, each scene's median step time is compared with the one stored in an earlier run's
+// JSON, and the exit code is 2 when any scene got slower by more than the tolerance (default 0.1)
+// and by more than the timer noise floor. The exit code is also 2 when a scene run for the same
+// number of steps ends with a check value further from the stored one than that scene allows.
+// A baseline recorded with a different number of workers is refused, with exit code 1.
+#include "JobSystem.h"
+#include "Log.h"
+#include "Physics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static double Seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void AddGround(PhysicsWorld &world) {
+    BodyDesc ground;
+    ground.shape = ShapeType::Plane;
+    world.AddBody(ground);
+}
+
+static BodyId AddBox(PhysicsWorld &world, const Vec3 &position, const Vec3 &halfExtents, Real mass = 1.0f) {
+    BodyDesc box;
+    box.shape = ShapeType::Box;
+    box.position = position;
+    box.halfExtents = halfExtents;
+    box.mass = mass;
+    return world.AddBody(box);
+}
+
+static BodyId AddSphere(PhysicsWorld &world, const Vec3 &position, Real radius, Real mass = 1.0f) {
+    BodyDesc sphere;
+    sphere.position = position;
+    sphere.radius = radius;
+    sphere.mass = mass;
+    return world.AddBody(sphere);
+}
+
+// ---- Scenes ----
+// Each builds into an empty world and returns a check value read after the last step, so a
+// change that breaks the simulation shows up next to its timings
+
+struct Scene {
+    const char *name;
+    const char *check;     // What Check() measures
+    double checkTolerance; // Largest drift from the baseline's check value that is not a failure
+    int steps;
+    void (*Build)(PhysicsWorld &world);
+    double (*Check)(const PhysicsWorld &world);
+};
+
+static const int PYRAMID_HEIGHT = 20;
+
+// A single-layer pyramid of unit boxes, 20 on the bottom row; the top box should stay put
+static void BuildPyramid(PhysicsWorld &world) {
+    AddGround(world);
+    for (int row = 0; row < PYRAMID_HEIGHT; ++row) {
+        int count = PYRAMID_HEIGHT - row;
+        for (int i = 0; i < count; ++i) {
+            Real x = (Real(i) - Real(count - 1) * Real(0.5f)) * Real(1.01f);
+            AddBox(world, Vec3(x, Real(0.5f) + Real(row), Real(0)), Vec3(0.5f, 0.5f, 0.5f));
+        }
+    }
+}
+
+static double TopHeight(const PhysicsWorld &world) {
+    return static_cast<double>(world.GetPosition(static_cast<BodyId>(world.BodyCount() - 1)).y);
+}
+
+// 10k spheres dropped in loose layers of 25x25 onto the ground plane
+static void BuildSpheres(PhysicsWorld &world) {
+    const int count = 10000, side = 25;
+    world.Reserve(count + 1);
+    AddGround(world);
+    for (int i = 0; i < count; ++i) {
+        int layer = i / (side * side), row = (i / side) % side, column = i % side;
+        Real jitter = Real((layer % 2) * 0.3f);
+        AddSphere(world, Vec3(Real(column - side / 2) * Real(1.1f) + jitter, Real(1) + Real(layer) * Real(1.2f),
+                              Real(row - side / 2) * Real(1.1f) + jitter),
+                  Real(0.5f));
+    }
+}
+
+static double MeanHeight(const PhysicsWorld &world) {
+    double sum = 0.0;
+    for (BodyId id = 1; id < world.BodyCount(); ++id) sum += static_cast<double>(world.GetPosition(id).y);
+    return sum / static_cast<double>(world.BodyCount() - 1);
+}
+
+static const int DOMINOES = 50;
+
+// A row of dominoes; the first is tipped over and should take the rest down with it
+static void BuildDominoes(PhysicsWorld &world) {
+    AddGround(world);
+    for (int i = 0; i < DOMINOES; ++i) {
+        BodyDesc domino;
+        domino.shape = ShapeType::Box;
+        domino.position = Vec3(Real(i) * Real(0.8f), Real(1), Real(0));
+        domino.halfExtents = Vec3(0.1f, 1.0f, 0.5f);
+        if (i == 0) domino.angularVelocity = Vec3(0, 0, -1.5f);
+        world.AddBody(domino);
+    }
+}
+
+static double Fallen(const PhysicsWorld &world) {
+    int fallen = 0;
+    for (BodyId id = 1; id < world.BodyCount(); ++id)
+        fallen += Rotate(world.GetOrientation(id), Vec3(0, 1, 0)).y < Real(0.7f);
+    return fallen;
+}
+
+// 50 ragdolls dropped in a heap. PhysicsWorld has no joints, so each ragdoll is its eleven body
+// parts posed together but free: the scene measures a dense pile of mixed, oddly sized shapes.
+// The pile is slow to settle: heavy chests propped on thin limbs now and then shift and wake the
+// main island again, and it is asleep only after about 1800 steps. The default 300 steps time it
+// while it is still active. Heads that fall clear are spheres with no rolling resistance, so
+// about 20 of them roll away across the ground and stay awake however long it runs.
+static void BuildRagdolls(PhysicsWorld &world) {
+    AddGround(world);
+    for (int i = 0; i < 50; ++i) {
+        Vec3 base(Real((i % 5) - 2) * Real(0.7f), Real(1.5f) + Real(i / 5) * Real(2.2f),
+                  Real((i / 5) % 2) * Real(0.4f));
+        // Head, chest and pelvis
+        AddSphere(world, base + Vec3(0, 0.95f, 0), Real(0.15f), Real(4));
+        AddBox(world, base + Vec3(0, 0.45f, 0), Vec3(0.2f, 0.3f, 0.12f), Real(20));
+        AddBox(world, base, Vec3(0.18f, 0.14f, 0.11f), Real(10));
+        // Upper and lower arms held out sideways, then upper and lower legs
+        for (int side = -1; side <= 1; side += 2) {
+            Real s = Real(side);
+            AddBox(world, base + Vec3(s * Real(0.38f), Real(0.6f), 0), Vec3(0.15f, 0.05f, 0.05f), Real(2));
+            AddBox(world, base + Vec3(s * Real(0.7f), Real(0.6f), 0), Vec3(0.15f, 0.045f, 0.045f), Real(1.5f));
+            AddBox(world, base + Vec3(s * Real(0.1f), Real(-0.35f), 0), Vec3(0.07f, 0.2f, 0.07f), Real(7));
+            AddBox(world, base + Vec3(s * Real(0.1f), Real(-0.8f), 0), Vec3(0.06f, 0.22f, 0.06f), Real(4));
+        }
+    }
+}
+
+static const Scene SCENES[] = {
+    {"pyramid", "top_height", 0.05, 300, BuildPyramid, TopHeight},
+    {"spheres", "mean_height", 0.05, 300, BuildSpheres, MeanHeight},
+    {"dominoes", "fallen", 0.5, 600, BuildDominoes, Fallen},
+    {"ragdolls", "mean_height", 0.05, 300, BuildRagdolls, MeanHeight},
+};
+
+// ---- Running and reporting ----
+
+static const double NOISE_FLOOR_MS = 0.05; // Smaller slowdowns are not regressions whatever their ratio
+
+struct SceneResult {
+    const Scene *scene = nullptr;
+    std::string json;
+    int steps = 0;
+    double medianMs = 0.0;
+    double checkValue = 0.0;
+};
+
+static double Percentile(const std::vector<double> &sorted, double p) {
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * static_cast<double>(sorted.size())))];
+}
+
+static SceneResult RunScene(const Scene &scene, int steps, JobSystem &jobs) {
+    PhysicsWorld world;
+    world.SetJobSystem(&jobs);
+    scene.Build(world);
+
+    const Real dt = Real(1) / Real(60);
+    std::vector<double> stepTimes;
+    stepTimes.reserve(steps);
+    double contacts = 0.0, pairs = 0.0, iterations = 0.0;
+    uint32_t maxContacts = 0;
+    for (int i = 0; i < steps; ++i) {
+        double start = Seconds();
+        world.Step(dt);
+        stepTimes.push_back((Seconds() - start) * 1e3);
+        const PhysicsStepStats &stats = world.GetStats();
+        contacts += stats.contacts, pairs += stats.pairs, iterations += stats.iterations;
+        maxContacts = std::max(maxContacts, stats.contacts);
+    }
+
+    double total = 0.0;
+    for (double t : stepTimes) total += t;
+    std::sort(stepTimes.begin(), stepTimes.end());
+    SceneResult result;
+    result.scene = &scene;
+    result.steps = steps;
+    result.medianMs = Percentile(stepTimes, 0.5);
+    result.checkValue = scene.Check(world);
+
+    char buffer[1024];
+    snprintf(buffer, sizeof(buffer),
+             "    {\"name\": \"%s\", \"bodies\": %zu, \"steps\": %d,\n"
+             "     \"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p90_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f,\n"
+             "     \"contacts_mean\": %.1f, \"contacts_max\": %u, \"pairs_mean\": %.1f, \"iterations_mean\": %.1f,\n"
+             "     \"awake_final\": %zu, \"%s\": %.4f}",
+             scene.name, world.BodyCount(), steps, total / steps, result.medianMs, Percentile(stepTimes, 0.9),
+             Percentile(stepTimes, 0.99), stepTimes.back(), contacts / steps, maxContacts, pairs / steps,
+             iterations / steps, world.AwakeBodyCount(), scene.check, result.checkValue);
+    result.json = buffer;
+    return result;
+}
+
+// A number stored under key in a scene's record of an earlier run's output, false if it is not
+// there. Only reads the JSON this program writes.
+static bool BaselineValue(const std::string &json, const std::string &scene, const std::string &key, double &value) {
+    size_t at = json.find("\"name\": \"" + scene + "\"");
+    if (at == std::string::npos) return false;
+    const std::string field = "\"" + key + "\":";
+    size_t end = json.find('}', at);
+    at = json.find(field, at);
+    if (at == std::string::npos || at > end) return false;
+    value = atof(json.c_str() + at + field.size());
+    return true;
+}
+
+// The worker count an earlier run's output was recorded with, -1 if it does not say
+static int BaselineWorkers(const std::string &json) {
+    const std::string field = "\"workers\":";
+    size_t at = json.find(field);
+    return at == std::string::npos ? -1 : atoi(json.c_str() + at + field.size());
+}
+
+int main(int argc, char **argv) {
+    const char *sceneName = nullptr;
+    const char *outputPath = nullptr;
+    const char *baselinePath = nullptr;
+    int steps = 0, workers = -1;
+    double tolerance = 0.1;
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--scene") == 0 && hasValue) {
+            sceneName = argv[++i];
+        } else if (strcmp(argv[i], "--steps") == 0 && hasValue) {
+            steps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && hasValue) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && hasValue) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && hasValue) {
+            baselinePath = argv[++i];
+        } else if (strcmp(argv[i], "--tolerance") == 0 && hasValue) {
+            tolerance = atof(argv[++i]);
+        } else {
+            LOG_ERROR("Unknown option: {}", argv[i]);
+            return 1;
+        }
+    }
+    if (steps < 0 || tolerance < 0.0) {
+        LOG_ERROR("--steps and --tolerance must be non-negative");
+        return 1;
+    }
+
+    std::string baseline;
+    if (baselinePath) {
+        std::ifstream file(baselinePath);
+        if (!file) {
+            LOG_ERROR("Cannot read baseline {}", baselinePath);
+            return 1;
+        }
+        std::stringstream contents;
+        contents << file.rdbuf();
+        baseline = contents.str();
+    }
+
+    JobSystem jobs;
+    if (!jobs.Start(workers)) return 1;
+
+    // Step times from a different number of workers cannot show a regression, or can hide one
+    if (!baseline.empty() && BaselineWorkers(baseline) != jobs.WorkerCount()) {
+        LOG_ERROR("Baseline {} was recorded with {} workers, this run has {}; pass --workers {}", baselinePath,
+                  BaselineWorkers(baseline), jobs.WorkerCount(), BaselineWorkers(baseline));
+        return 1;
+    }
+
+    std::vector<SceneResult> results;
+    for (const Scene &scene : SCENES) {
+        if (sceneName && strcmp(sceneName, scene.name) != 0) continue;
+        LOG_INFO("Running {}", scene.name);
+        results.push_back(RunScene(scene, steps > 0 ? steps : scene.steps, jobs));
+    }
+    jobs.Stop();
+    if (results.empty()) {
+        LOG_ERROR("No scene named {}", sceneName);
+        return 1;
+    }
+
+    std::string json = "{\n  \"workers\": " + std::to_string(jobs.WorkerCount()) + ",\n";
+#ifdef PHYSICS_FIXED_POINT
+    json += "  \"real\": \"fixed\",\n";
+#else
+    json += "  \"real\": \"float\",\n";
+#endif
+    json += "  \"scenes\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) json += results[i].json + (i + 1 < results.size() ? ",\n" : "\n");
+    json += "  ]\n}\n";
+
+    if (outputPath) {
+        std::ofstream file(outputPath);
+        file << json;
+        if (!file) {
+            LOG_ERROR("Cannot write {}", outputPath);
+            return 1;
+        }
+    } else {
+        fputs(json.c_str(), stdout);
+    }
+
+    if (baseline.empty()) return 0;
+    int regressions = 0;
+    for (const SceneResult &result : results) {
+        const Scene &scene = *result.scene;
+        double before, baselineSteps;
+        if (!BaselineValue(baseline, scene.name, "p50_ms", before) || before <= 0.0) {
+            LOG_WARN("{}: not in the baseline", scene.name);
+            continue;
+        }
+        double change = result.medianMs / before - 1.0;
+        bool slower = change > tolerance && result.medianMs - before > NOISE_FLOOR_MS;
+        regressions += slower;
+        fprintf(stderr, "%-10s p50 %8.3f ms, baseline %8.3f ms, %+6.1f%%%s\n", scene.name, result.medianMs, before,
+                change * 100.0, slower ? "  REGRESSION" : "");
+
+        // The check value depends on how far the scene ran, so only a run of the same length compares
+        double expected;
+        if (!BaselineValue(baseline, scene.name, "steps", baselineSteps) || baselineSteps != result.steps ||
+            !BaselineValue(baseline, scene.name, scene.check, expected)) {
+            LOG_WARN("{}: baseline ran a different number of steps, {} not compared", scene.name, scene.check);
+            continue;
+        }
+        bool drifted = std::abs(result.checkValue - expected) > scene.checkTolerance;
+        regressions += drifted;
+        fprintf(stderr, "%-10s %s %.4f, baseline %.4f%s\n", "", scene.check, result.checkValue, expected,
+                drifted ? "  CHECK FAILED" : "");
+    }
+    return regressions > 0 ? 2 : 0;
+}
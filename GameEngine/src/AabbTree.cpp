@@ -0,0 +1,273 @@
+#include "AabbTree.h"
+
+#include <algorithm>
+
+int32_t AabbTree::AllocateNode() {
+    int32_t index;
+    if (freeList != NULL_NODE) {
+        index = freeList;
+        freeList = nodes[index].parent;
+    } else {
+        index = static_cast<int32_t>(nodes.size());
+        nodes.push_back(Node());
+    }
+    Node &node = nodes[index];
+    node.parent = node.child1 = node.child2 = NULL_NODE;
+    node.height = 0;
+    node.userData = 0;
+    return index;
+}
+
+void AabbTree::FreeNode(int32_t index) {
+    nodes[index].parent = freeList;
+    nodes[index].height = -1;
+    freeList = index;
+}
+
+int32_t AabbTree::Insert(const Aabb &box, uint32_t userData) {
+    int32_t leaf = AllocateNode();
+    nodes[leaf].box = box;
+    nodes[leaf].userData = userData;
+    InsertLeaf(leaf);
+    leafCount++;
+    return leaf;
+}
+
+void AabbTree::Remove(int32_t proxy) {
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    leafCount--;
+}
+
+bool AabbTree::Move(int32_t proxy, const Aabb &tight, const Aabb &fat) {
+    if (nodes[proxy].box.Contains(tight)) return false;
+    RemoveLeaf(proxy);
+    nodes[proxy].box = fat;
+    InsertLeaf(proxy);
+    return true;
+}
+
+void AabbTree::Clear() {
+    nodes.clear();
+    root = freeList = NULL_NODE;
+    leafCount = 0;
+}
+
+// Walk down to the sibling that makes the new parent cheapest: the area of the new parent plus
+// the area every ancestor grows by. A child is only worth entering if even the best case there
+// beats stopping here.
+void AabbTree::InsertLeaf(int32_t leaf) {
+    if (root == NULL_NODE) {
+        root = leaf;
+        nodes[root].parent = NULL_NODE;
+        return;
+    }
+
+    const Aabb box = nodes[leaf].box;
+    int32_t index = root;
+    while (!nodes[index].IsLeaf()) {
+        const Node &node = nodes[index];
+        Real area = node.box.Area();
+        Real combinedArea = Union(node.box, box).Area();
+        Real cost = Real(2) * combinedArea;                  // New parent here
+        Real inheritance = Real(2) * (combinedArea - area); // What pushing further down adds above
+
+        auto descendCost = [&](int32_t child) {
+            const Node &c = nodes[child];
+            Real grown = Union(box, c.box).Area();
+            return (c.IsLeaf() ? grown : grown - c.box.Area()) + inheritance;
+        };
+        Real cost1 = descendCost(node.child1), cost2 = descendCost(node.child2);
+        if (cost < cost1 && cost < cost2) break;
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    int32_t sibling = index;
+    int32_t oldParent = nodes[sibling].parent;
+    int32_t newParent = AllocateNode();
+    Node &parent = nodes[newParent];
+    parent.parent = oldParent;
+    parent.box = Union(box, nodes[sibling].box);
+    parent.height = nodes[sibling].height + 1;
+    parent.child1 = sibling;
+    parent.child2 = leaf;
+
+    if (oldParent != NULL_NODE) {
+        if (nodes[oldParent].child1 == sibling)
+            nodes[oldParent].child1 = newParent;
+        else
+            nodes[oldParent].child2 = newParent;
+    } else {
+        root = newParent;
+    }
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    FixUpwards(oldParent);
+}
+
+void AabbTree::RemoveLeaf(int32_t leaf) {
+    if (leaf == root) {
+        root = NULL_NODE;
+        return;
+    }
+
+    int32_t parent = nodes[leaf].parent;
+    int32_t grandParent = nodes[parent].parent;
+    int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    if (grandParent != NULL_NODE) {
+        if (nodes[grandParent].child1 == parent)
+            nodes[grandParent].child1 = sibling;
+        else
+            nodes[grandParent].child2 = sibling;
+        nodes[sibling].parent = grandParent;
+        FreeNode(parent);
+        FixUpwards(grandParent);
+    } else {
+        root = sibling;
+        nodes[sibling].parent = NULL_NODE;
+        FreeNode(parent);
+    }
+}
+
+void AabbTree::FixUpwards(int32_t index) {
+    while (index != NULL_NODE) {
+        index = Balance(index);
+        Node &node = nodes[index];
+        const Node &c1 = nodes[node.child1], &c2 = nodes[node.child2];
+        node.height = 1 + std::max(c1.height, c2.height);
+        node.box = Union(c1.box, c2.box);
+        index = node.parent;
+    }
+}
+
+// If one child of A is more than one level taller than the other, rotate it up to take A's place.
+// With C = A.child2 too tall and children F and G: C becomes the parent of A, keeps the taller of
+// F and G, and hands the shorter one to A in place of C. AVL-style, on heights only.
+// Returns the index now at A's position.
+int32_t AabbTree::Balance(int32_t iA) {
+    Node &A = nodes[iA];
+    if (A.IsLeaf() || A.height < 2) return iA;
+
+    int32_t iB = A.child1, iC = A.child2;
+    Node &B = nodes[iB], &C = nodes[iC];
+    int32_t balance = C.height - B.height;
+
+    // Promote whichever child is too tall; mirror images of each other
+    auto rotate = [&](int32_t iUp, Node &up, Node &other, bool upIsChild2) {
+        int32_t iF = up.child1, iG = up.child2;
+        Node &F = nodes[iF], &G = nodes[iG];
+
+        up.child1 = iA;
+        up.parent = A.parent;
+        A.parent = iUp;
+        if (up.parent != NULL_NODE) {
+            if (nodes[up.parent].child1 == iA)
+                nodes[up.parent].child1 = iUp;
+            else
+                nodes[up.parent].child2 = iUp;
+        } else {
+            root = iUp;
+        }
+
+        // The taller grandchild stays with up, the shorter one moves under A in up's old slot
+        bool keepF = F.height > G.height;
+        int32_t iKeep = keepF ? iF : iG, iMove = keepF ? iG : iF;
+        Node &keep = nodes[iKeep], &move = nodes[iMove];
+        up.child2 = iKeep;
+        if (upIsChild2)
+            A.child2 = iMove;
+        else
+            A.child1 = iMove;
+        move.parent = iA;
+
+        A.box = Union(other.box, move.box);
+        up.box = Union(A.box, keep.box);
+        A.height = 1 + std::max(other.height, move.height);
+        up.height = 1 + std::max(A.height, keep.height);
+    };
+
+    if (balance > 1) {
+        rotate(iC, C, B, true);
+        return iC;
+    }
+    if (balance < -1) {
+        rotate(iB, B, C, false);
+        return iB;
+    }
+    return iA;
+}
+
+void AabbTree::Refit() {
+    if (root == NULL_NODE) return;
+
+    // Breadth-first order lists every parent before its children, so walking it backwards refits bottom-up
+    scratch.clear();
+    scratch.push_back(root);
+    for (size_t i = 0; i < scratch.size(); ++i) {
+        const Node &node = nodes[scratch[i]];
+        if (node.IsLeaf()) continue;
+        scratch.push_back(node.child1);
+        scratch.push_back(node.child2);
+    }
+    for (size_t i = scratch.size(); i-- > 0;) {
+        Node &node = nodes[scratch[i]];
+        if (!node.IsLeaf()) node.box = Union(nodes[node.child1].box, nodes[node.child2].box);
+    }
+}
+
+void AabbTree::Rebuild() {
+    scratch.clear();
+    for (int32_t i = 0; i < static_cast<int32_t>(nodes.size()); ++i) {
+        Node &node = nodes[i];
+        if (node.height < 0) continue;
+        if (node.IsLeaf())
+            scratch.push_back(i);
+        else
+            FreeNode(i);
+    }
+    if (scratch.empty()) return;
+
+    root = BuildTopDown(scratch.data(), static_cast<int32_t>(scratch.size()));
+    nodes[root].parent = NULL_NODE;
+}
+
+int32_t AabbTree::BuildTopDown(int32_t *leaves, int32_t count) {
+    if (count == 1) return leaves[0];
+
+    Aabb centers{nodes[leaves[0]].box.Center(), nodes[leaves[0]].box.Center()};
+    for (int32_t i = 1; i < count; ++i) {
+        Vec3 c = nodes[leaves[i]].box.Center();
+        centers.min = Min(centers.min, c);
+        centers.max = Max(centers.max, c);
+    }
+    Vec3 extent = centers.max - centers.min;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    int32_t half = count / 2;
+    std::nth_element(leaves, leaves + half, leaves + count, [&](int32_t a, int32_t b) {
+        return nodes[a].box.Center()[axis] < nodes[b].box.Center()[axis];
+    });
+
+    int32_t child1 = BuildTopDown(leaves, half);
+    int32_t child2 = BuildTopDown(leaves + half, count - half);
+    int32_t index = AllocateNode();
+    Node &node = nodes[index];
+    node.child1 = child1;
+    node.child2 = child2;
+    node.box = Union(nodes[child1].box, nodes[child2].box);
+    node.height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+    nodes[child1].parent = nodes[child2].parent = index;
+    return index;
+}
+
+Real AabbTree::AreaRatio() const {
+    if (root == NULL_NODE) return Real(0);
+    Real rootArea = nodes[root].box.Area();
+    if (rootArea <= Real(0)) return Real(0);
+    Real total = Real(0);
+    for (int32_t i = 0; i < static_cast<int32_t>(nodes.size()); ++i)
+        if (nodes[i].height > 0 && i != root) total += nodes[i].box.Area();
+    return total / rootArea;
+}
@@ -0,0 +1,168 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include "Memory.h"
+#include "PhysicsMath.h"
+
+#include <cstdint>
+
+#if defined(__SSE2__) && !defined(PHYSICS_FIXED_POINT)
+#include <emmintrin.h>
+#endif
+
+// Bounding volume hierarchy over fattened AABBs, used by the physics broad phase.
+//
+// Leaves store a box larger than the object it bounds, so an object that moves a little stays
+// inside its leaf and the tree is untouched. One that leaves it is removed and reinserted in
+// O(log n); insertion descends by surface area cost and rebalances with rotations on the way up.
+// For large batches of movement, leaves can be enlarged in place and the whole tree refit in a
+// single bottom-up pass instead. Rebuild() makes a fresh top-down tree, for geometry that rarely
+// changes.
+class AabbTree {
+  public:
+    static constexpr int32_t NULL_NODE = -1;
+
+    // Add a leaf for box, returns its proxy. userData comes back from queries.
+    int32_t Insert(const Aabb &box, uint32_t userData);
+    void Remove(int32_t proxy);
+
+    // Move a proxy to a new fattened box. Returns false (and does nothing) while the new tight
+    // box still fits inside the current fattened one.
+    bool Move(int32_t proxy, const Aabb &tight, const Aabb &fat);
+
+    // Batch path: replace a leaf box without restructuring, then Refit() once for all of them
+    void SetLeafBox(int32_t proxy, const Aabb &fat) { nodes[proxy].box = fat; }
+    void Refit();
+
+    // Rebuild the whole tree top-down from its leaves, splitting at the median of the widest axis
+    void Rebuild();
+
+    void Clear();
+
+    const Aabb &GetFatBox(int32_t proxy) const { return nodes[proxy].box; }
+    uint32_t GetUserData(int32_t proxy) const { return nodes[proxy].userData; }
+    int32_t GetHeight() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+    int32_t LeafCount() const { return leafCount; }
+    // Total internal node area over root area; grows as refits degrade the tree
+    Real AreaRatio() const;
+
+    // Call f(userData) for every leaf whose fattened box overlaps box. f returns false to stop.
+    template <typename F> void Query(const Aabb &box, F &&f) const {
+        if (root == NULL_NODE) return;
+        int32_t stack[STACK_SIZE];
+        int count = 0;
+        stack[count++] = root;
+        while (count > 0) {
+            const Node &node = nodes[stack[--count]];
+            if (!node.box.Overlaps(box)) continue;
+            if (node.IsLeaf()) {
+                if (!f(node.userData)) return;
+            } else {
+                stack[count++] = node.child1;
+                stack[count++] = node.child2;
+            }
+        }
+    }
+
+    // Four rays, or swept spheres, traced together with one lane each. Directions are stored
+    // inverted; a zero component should be a huge finite value of the right sign, not infinity.
+    struct RayPacket {
+        Real ox[4], oy[4], oz[4];
+        Real invDx[4], invDy[4], invDz[4];
+        Real radius[4]; // Node boxes are grown by this for sphere casts
+        Real maxT[4];   // Nodes entered beyond this are skipped; lower it as hits come in, < 0 retires the lane
+    };
+
+    // Call f(userData, lanes) for every leaf entered by at least one lane in mask, lanes being the
+    // bitmask of those that do. The lanes share one stack and test each node four at a time.
+    // Children nearer the first lane's origin are visited first, so closest-hit searches can
+    // shrink maxT early.
+    template <typename F> void CastPacket(RayPacket &packet, uint32_t mask, F &&f) const {
+        if (root == NULL_NODE || mask == 0) return;
+        int first = 0;
+        while (!(mask & (1u << first))) first++;
+        const Vec3 origin(packet.ox[first], packet.oy[first], packet.oz[first]);
+
+        int32_t stack[STACK_SIZE];
+        int count = 0;
+        stack[count++] = root;
+        while (count > 0) {
+            const Node &node = nodes[stack[--count]];
+            uint32_t lanes = EnteredLanes(node.box, packet) & mask;
+            if (lanes == 0) continue;
+            if (node.IsLeaf()) {
+                f(node.userData, lanes);
+                continue;
+            }
+            // Popped last is visited first
+            Real d1 = LengthSquared(nodes[node.child1].box.Center() - origin);
+            Real d2 = LengthSquared(nodes[node.child2].box.Center() - origin);
+            stack[count++] = d1 < d2 ? node.child2 : node.child1;
+            stack[count++] = d1 < d2 ? node.child1 : node.child2;
+        }
+    }
+
+  private:
+    // Deep enough for any tree rotations keep balanced, and for Rebuild's median splits
+    static const int STACK_SIZE = 256;
+
+    struct Node {
+        Aabb box;
+        int32_t parent;    // Next free node while on the free list
+        int32_t child1, child2;
+        int32_t height;    // Leaf 0, free -1
+        uint32_t userData; // Leaves only
+
+        bool IsLeaf() const { return child1 == NULL_NODE; }
+    };
+
+    // Bitmask of the packet lanes whose ray enters box (grown by the lane radius) within [0, maxT]
+    static uint32_t EnteredLanes(const Aabb &box, const RayPacket &p) {
+#if defined(__SSE2__) && !defined(PHYSICS_FIXED_POINT)
+        const __m128 r = _mm_loadu_ps(p.radius);
+        __m128 tNear = _mm_setzero_ps(), tFar = _mm_loadu_ps(p.maxT);
+        auto slab = [&](Real lo, Real hi, const Real *o, const Real *invD) {
+            __m128 origin = _mm_loadu_ps(o), inv = _mm_loadu_ps(invD);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(lo), r), origin), inv);
+            __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_set1_ps(hi), r), origin), inv);
+            tNear = _mm_max_ps(tNear, _mm_min_ps(t1, t2));
+            tFar = _mm_min_ps(tFar, _mm_max_ps(t1, t2));
+        };
+        slab(box.min.x, box.max.x, p.ox, p.invDx);
+        slab(box.min.y, box.max.y, p.oy, p.invDy);
+        slab(box.min.z, box.max.z, p.oz, p.invDz);
+        return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)));
+#else
+        uint32_t lanes = 0;
+        for (int i = 0; i < 4; ++i) {
+            Real tNear = Real(0), tFar = p.maxT[i];
+            auto slab = [&](Real lo, Real hi, Real o, Real invD) {
+                Real t1 = (lo - p.radius[i] - o) * invD, t2 = (hi + p.radius[i] - o) * invD;
+                tNear = Max(tNear, Min(t1, t2));
+                tFar = Min(tFar, Max(t1, t2));
+            };
+            slab(box.min.x, box.max.x, p.ox[i], p.invDx[i]);
+            slab(box.min.y, box.max.y, p.oy[i], p.invDy[i]);
+            slab(box.min.z, box.max.z, p.oz[i], p.invDz[i]);
+            if (tNear <= tFar) lanes |= 1u << i;
+        }
+        return lanes;
+#endif
+    }
+
+    int32_t AllocateNode();
+    void FreeNode(int32_t index);
+    void InsertLeaf(int32_t leaf);
+    void RemoveLeaf(int32_t leaf);
+    int32_t Balance(int32_t index);
+    void FixUpwards(int32_t index); // Rebalance and refit from index to the root
+    int32_t BuildTopDown(int32_t *leaves, int32_t count);
+
+    TaggedVector<Node, MemTag::Physics> nodes;
+    TaggedVector<int32_t, MemTag::Physics> scratch; // Rebuild and Refit working set
+    int32_t root = NULL_NODE;
+    int32_t freeList = NULL_NODE;
+    int32_t leafCount = 0;
+};
+
+#endif
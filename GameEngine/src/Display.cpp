@@ -0,0 +1,265 @@
+#include "Display.h"
+#include "Log.h"
+
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef ENGINE_WITH_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#ifdef ENGINE_WITH_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+// ---- GlfwDisplay ----
+
+bool GlfwDisplay::Create(int width, int height, const char *title, bool vsync) {
+    if (!glfwInit()) {
+        LOG_ERROR("GLFW init failed");
+        return false;
+    }
+    initialized = true;
+
+    window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+    if (!window) {
+        LOG_ERROR("GLFW window creation failed");
+        return false;
+    }
+
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(vsync ? 1 : 0);
+
+    // Everything that can change what is on screen counts as activity
+    glfwSetWindowUserPointer(window, this);
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow *w, int, int) { OnActivity(w); });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow *w) { OnActivity(w); });
+    glfwSetKeyCallback(window, [](GLFWwindow *w, int, int, int, int) { OnActivity(w); });
+    glfwSetCursorPosCallback(window, [](GLFWwindow *w, double, double) { OnActivity(w); });
+    glfwSetMouseButtonCallback(window, [](GLFWwindow *w, int, int, int) { OnActivity(w); });
+    glfwSetScrollCallback(window, [](GLFWwindow *w, double, double) { OnActivity(w); });
+    return true;
+}
+
+void GlfwDisplay::OnActivity(GLFWwindow *window) {
+    static_cast<GlfwDisplay *>(glfwGetWindowUserPointer(window))->NotifyActivity();
+}
+
+void GlfwDisplay::Destroy() {
+    if (window) {
+        glfwDestroyWindow(window);
+        window = nullptr;
+    }
+    if (initialized) {
+        glfwTerminate();
+        initialized = false;
+    }
+}
+
+bool GlfwDisplay::ShouldClose() const { return glfwWindowShouldClose(window); }
+
+void GlfwDisplay::RequestClose() { glfwSetWindowShouldClose(window, true); }
+
+void GlfwDisplay::SwapBuffers() { glfwSwapBuffers(window); }
+
+void GlfwDisplay::PollEvents() { glfwPollEvents(); }
+
+void GlfwDisplay::WaitEvents(double timeout) { glfwWaitEventsTimeout(timeout); }
+
+void GlfwDisplay::Wake() { glfwPostEmptyEvent(); }
+
+bool GlfwDisplay::IsKeyDown(int key) const { return glfwGetKey(window, key) == GLFW_PRESS; }
+
+void GlfwDisplay::SetTitle(const char *title) { glfwSetWindowTitle(window, title); }
+
+void GlfwDisplay::GetFramebufferSize(int &width, int &height) const { glfwGetFramebufferSize(window, &width, &height); }
+
+// ---- HeadlessDisplay ----
+
+bool HeadlessDisplay::Create(int w, int h, const char *, bool) {
+    width = w;
+    height = h;
+    closeRequested = false;
+
+    return api == EGL ? CreateEglContext() : CreateOsMesaContext();
+}
+
+bool HeadlessDisplay::CreateEglContext() {
+#ifdef ENGINE_WITH_EGL
+    // Mesa's surfaceless platform needs neither an X server nor a window system at all
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        LOG_ERROR("EGL init failed");
+        return false;
+    }
+    eglDisplay = display;
+
+    const EGLint pbufferConfig[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    const EGLint anyConfig[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config;
+    EGLint configCount = 0;
+    bool hasPbuffer = eglChooseConfig(display, pbufferConfig, &config, 1, &configCount) && configCount > 0;
+    if (!hasPbuffer && (!eglChooseConfig(display, anyConfig, &config, 1, &configCount) || configCount == 0)) {
+        LOG_ERROR("EGL: no desktop GL config");
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        LOG_ERROR("EGL: desktop GL not supported");
+        return false;
+    }
+
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+    if (context == EGL_NO_CONTEXT) {
+        LOG_ERROR("EGL context creation failed");
+        return false;
+    }
+    eglContext = context;
+
+    // Surfaceless when the driver allows it, otherwise a 1x1 pbuffer just to make the context current;
+    // either way all drawing goes to our own FBO
+    const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+    bool surfaceless = extensions && strstr(extensions, "EGL_KHR_surfaceless_context");
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (!surfaceless && hasPbuffer) {
+        const EGLint pbufferSize[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        surface = eglCreatePbufferSurface(display, config, pbufferSize);
+        eglSurface = surface;
+    }
+
+    if (!eglMakeCurrent(display, surface, surface, context)) {
+        LOG_ERROR("EGL: cannot make context current");
+        return false;
+    }
+    return true;
+#else
+    LOG_ERROR("Built without EGL support");
+    return false;
+#endif
+}
+
+bool HeadlessDisplay::CreateOsMesaContext() {
+#ifdef ENGINE_WITH_OSMESA
+    OSMesaContext context = OSMesaCreateContextExt(OSMESA_RGBA, 24, 0, 0, nullptr);
+    if (!context) {
+        LOG_ERROR("OSMesa context creation failed");
+        return false;
+    }
+    osMesaContext = context;
+
+    osMesaBuffer = new unsigned char[static_cast<size_t>(width) * height * 4];
+    if (!OSMesaMakeCurrent(context, osMesaBuffer, GL_UNSIGNED_BYTE, width, height)) {
+        LOG_ERROR("OSMesa: cannot make context current");
+        return false;
+    }
+    return true;
+#else
+    LOG_ERROR("Built without OSMesa support");
+    return false;
+#endif
+}
+
+bool HeadlessDisplay::CreateFramebuffer() {
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) LOG_ERROR("Offscreen framebuffer incomplete");
+    return complete;
+}
+
+void HeadlessDisplay::WaitEvents(double timeout) {
+    // No event source offscreen, so idling is just sleeping
+    std::this_thread::sleep_for(std::chrono::duration<double>(timeout));
+}
+
+void HeadlessDisplay::SwapBuffers() {
+    // Nothing to present; wait for the GPU so frame times include the actual rendering
+    glFinish();
+}
+
+void HeadlessDisplay::Destroy() {
+    if (fbo) {
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        fbo = colorBuffer = depthBuffer = 0;
+    }
+
+#ifdef ENGINE_WITH_EGL
+    if (eglDisplay) {
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (eglSurface) eglDestroySurface(eglDisplay, eglSurface);
+        if (eglContext) eglDestroyContext(eglDisplay, eglContext);
+        eglTerminate(eglDisplay);
+        eglDisplay = eglContext = eglSurface = nullptr;
+    }
+#endif
+
+#ifdef ENGINE_WITH_OSMESA
+    if (osMesaContext) {
+        OSMesaDestroyContext(static_cast<OSMesaContext>(osMesaContext));
+        osMesaContext = nullptr;
+    }
+#endif
+    delete[] osMesaBuffer;
+    osMesaBuffer = nullptr;
+}
+
+// ---- Factory and frame dump ----
+
+Display *CreateDisplay(const std::string &name) {
+    if (name == "glfw") return new GlfwDisplay();
+#ifdef ENGINE_WITH_EGL
+    if (name == "egl") return new HeadlessDisplay(HeadlessDisplay::EGL);
+#endif
+#ifdef ENGINE_WITH_OSMESA
+    if (name == "osmesa") return new HeadlessDisplay(HeadlessDisplay::OSMESA);
+#endif
+    return nullptr;
+}
+
+bool DumpFramebuffer(GLuint framebuffer, int width, int height, const std::string &path, unsigned long long &hash) {
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 3);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    // FNV-1a over the rows as read (bottom-up), independent of the file format
+    hash = 1469598103934665603ULL;
+    for (unsigned char byte : pixels) {
+        hash ^= byte;
+        hash *= 1099511628211ULL;
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    // GL rows start at the bottom, PPM rows at the top
+    for (int y = height - 1; y >= 0; --y) fwrite(&pixels[static_cast<size_t>(y) * width * 3], 1, width * 3, file);
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,127 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <GL/glew.h>
+#include <string>
+
+// Owns the GL context and the surface frames end up on: a GLFW window,
+// or an offscreen framebuffer for display-less machines.
+class Display {
+  public:
+    virtual ~Display() {}
+
+    // Create the context and make it current on the calling thread
+    virtual bool Create(int width, int height, const char *title, bool vsync) = 0;
+    virtual void Destroy() = 0;
+
+    // Called once GL entry points are loaded, for setup that needs them
+    virtual bool OnGlLoaded() { return true; }
+
+    virtual bool ShouldClose() const = 0;
+    virtual void RequestClose() = 0;
+    virtual void SwapBuffers() = 0;
+    virtual void PollEvents() = 0;
+    virtual void WaitEvents(double timeout) = 0; // Block until an event arrives or timeout seconds pass
+    virtual void Wake() {}                       // Make a WaitEvents on the main thread return early, any thread
+    virtual bool IsKeyDown(int key) const = 0;   // GLFW key codes
+    virtual void SetTitle(const char *title) = 0;
+    virtual void GetFramebufferSize(int &width, int &height) const = 0;
+
+    // Framebuffer the finished frame must be drawn into (0 = window back buffer)
+    virtual GLuint TargetFramebuffer() const { return 0; }
+
+    // Called on any input, resize or expose event, so on-demand rendering knows to redraw
+    void SetActivityCallback(void (*callback)(void *data), void *data) {
+        activityCallback = callback;
+        activityData = data;
+    }
+
+  protected:
+    void NotifyActivity() {
+        if (activityCallback) activityCallback(activityData);
+    }
+
+  private:
+    void (*activityCallback)(void *data) = nullptr;
+    void *activityData = nullptr;
+};
+
+// Regular desktop window through GLFW
+class GlfwDisplay : public Display {
+  public:
+    bool Create(int width, int height, const char *title, bool vsync) override;
+    void Destroy() override;
+
+    bool ShouldClose() const override;
+    void RequestClose() override;
+    void SwapBuffers() override;
+    void PollEvents() override;
+    void WaitEvents(double timeout) override;
+    void Wake() override;
+    bool IsKeyDown(int key) const override;
+    void SetTitle(const char *title) override;
+    void GetFramebufferSize(int &width, int &height) const override;
+
+    struct GLFWwindow *Window() const { return window; }
+
+  private:
+    static void OnActivity(struct GLFWwindow *window);
+    struct GLFWwindow *window = nullptr;
+    bool initialized = false;
+};
+
+// Offscreen context (EGL surfaceless/pbuffer, or OSMesa on llvmpipe) rendering into an FBO.
+// Never closes by itself; the engine stops it after --frames.
+class HeadlessDisplay : public Display {
+  public:
+    enum Api { EGL, OSMESA };
+
+    explicit HeadlessDisplay(Api api) : api(api) {}
+    ~HeadlessDisplay() override { Destroy(); }
+
+    bool Create(int width, int height, const char *title, bool vsync) override;
+    void Destroy() override;
+    bool OnGlLoaded() override { return CreateFramebuffer(); }
+
+    bool ShouldClose() const override { return closeRequested; }
+    void RequestClose() override { closeRequested = true; }
+    void SwapBuffers() override;
+    void PollEvents() override {}
+    void WaitEvents(double timeout) override;
+    bool IsKeyDown(int) const override { return false; }
+    void SetTitle(const char *) override {}
+    void GetFramebufferSize(int &w, int &h) const override {
+        w = width;
+        h = height;
+    }
+
+    GLuint TargetFramebuffer() const override { return fbo; }
+
+  private:
+    bool CreateEglContext();
+    bool CreateOsMesaContext();
+    bool CreateFramebuffer();
+
+    Api api;
+    int width = 0, height = 0;
+    bool closeRequested = false;
+
+    // EGL handles kept as void* so this header does not drag in EGL
+    void *eglDisplay = nullptr;
+    void *eglContext = nullptr;
+    void *eglSurface = nullptr;
+
+    void *osMesaContext = nullptr;
+    unsigned char *osMesaBuffer = nullptr;
+
+    GLuint fbo = 0, colorBuffer = 0, depthBuffer = 0;
+};
+
+// "glfw", "egl" or "osmesa"; returns nullptr for an unknown or compiled-out backend
+Display *CreateDisplay(const std::string &name);
+
+// Read back the current target framebuffer as RGB and write it as a binary PPM.
+// hash receives a 64-bit FNV-1a of the pixels for image regression checks.
+bool DumpFramebuffer(GLuint framebuffer, int width, int height, const std::string &path, unsigned long long &hash);
+
+#endif
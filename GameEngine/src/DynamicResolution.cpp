@@ -0,0 +1,127 @@
+#include "DynamicResolution.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Controller tuning: stay put while GPU time is inside [LOW, HIGH] x target
+static const double HIGH_WATER = 1.0;
+static const double LOW_WATER = 0.8;
+static const double SMOOTHING = 0.1;     // EMA weight of a new measurement
+static const int SETTLE_SAMPLES = 8;     // Measurements ignored after each change
+static const float SCALE_STEP = 0.05f;   // Scales are multiples of this, so small noise does not reallocate anything
+static const double MAX_PLAUSIBLE = 1.0; // Seconds; llvmpipe returns garbage for the very first query
+
+bool DynamicResolution::Init(double targetGpuTime, float minimumScale) {
+    target = targetGpuTime;
+    minScale = std::min(1.0f, std::max(SCALE_STEP, minimumScale));
+    scale = 1.0f;
+    smoothed = 0.0;
+    cooldown = 0;
+
+    glGenQueries(QUERY_COUNT, queries);
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &colorBuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    return true;
+}
+
+void DynamicResolution::Destroy() {
+    if (!fbo) return;
+    glDeleteQueries(QUERY_COUNT, queries);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    fbo = colorBuffer = depthBuffer = 0;
+    fboWidth = fboHeight = 0;
+}
+
+void DynamicResolution::Resize(int width, int height) {
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        LOG_ERROR("Dynamic resolution framebuffer incomplete at {}x{}", width, height);
+
+    fboWidth = width;
+    fboHeight = height;
+}
+
+void DynamicResolution::BeginScene(int width, int height) {
+    // Storage covers the full output; lower scales render into its corner
+    if (width != fboWidth || height != fboHeight) Resize(width, height);
+    outputWidth = width;
+    outputHeight = height;
+    sceneWidth = std::max(1, static_cast<int>(std::lround(width * scale)));
+    sceneHeight = std::max(1, static_cast<int>(std::lround(height * scale)));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, sceneWidth, sceneHeight);
+
+    // Every slot still pending means the GPU is QUERY_COUNT frames behind; skip timing this one
+    if (!queryPending[nextQuery]) glBeginQuery(GL_TIME_ELAPSED, queries[nextQuery]);
+}
+
+void DynamicResolution::EndScene(GLuint target) {
+    if (!queryPending[nextQuery]) {
+        glEndQuery(GL_TIME_ELAPSED);
+        queryPending[nextQuery] = true;
+        nextQuery = (nextQuery + 1) % QUERY_COUNT;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+    glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, outputWidth, outputHeight, GL_COLOR_BUFFER_BIT,
+                      sceneWidth == outputWidth ? GL_NEAREST : GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glViewport(0, 0, outputWidth, outputHeight);
+}
+
+bool DynamicResolution::PollGpuTime(double &seconds) {
+    // Oldest pending query first: it is the one most likely to be done
+    for (int i = 0; i < QUERY_COUNT; ++i) {
+        int slot = (nextQuery + i) % QUERY_COUNT;
+        if (!queryPending[slot]) continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) return false;
+
+        GLuint64 nanos = 0;
+        glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &nanos);
+        queryPending[slot] = false;
+        seconds = nanos * 1e-9;
+        if (seconds > MAX_PLAUSIBLE) return false;
+        Adjust(seconds);
+        return true;
+    }
+    return false;
+}
+
+void DynamicResolution::Adjust(double gpuTime) {
+    smoothed = smoothed > 0.0 ? smoothed + SMOOTHING * (gpuTime - smoothed) : gpuTime;
+    if (cooldown > 0) {
+        --cooldown;
+        return;
+    }
+    if (smoothed <= 0.0 || (smoothed >= target * LOW_WATER && smoothed <= target * HIGH_WATER)) return;
+
+    // GPU time tracks pixel count, which goes with the square of the scale. Aim for the middle
+    // of the band, and limit each step so one bad frame cannot crater the resolution.
+    double ratio = std::sqrt(target * 0.5 * (LOW_WATER + HIGH_WATER) / smoothed);
+    ratio = std::min(1.25, std::max(0.75, ratio));
+    float wanted = std::round(static_cast<float>(scale * ratio) / SCALE_STEP) * SCALE_STEP;
+    wanted = std::min(1.0f, std::max(minScale, wanted));
+    if (wanted == scale) return;
+
+    LOG_DEBUG("Render scale {} -> {} (GPU {} ms, target {} ms)", scale, wanted, smoothed * 1e3, target * 1e3);
+    // Expect the new cost right away rather than waiting for the average to drift there
+    smoothed *= (wanted * wanted) / (scale * scale);
+    scale = wanted;
+    cooldown = SETTLE_SAMPLES;
+}
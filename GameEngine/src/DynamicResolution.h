@@ -0,0 +1,48 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <GL/glew.h>
+
+// Renders the scene into an offscreen framebuffer at a fraction of the output size and
+// upscales it, picking the fraction from measured GPU time so the scene holds a target cost.
+// GPU time comes from timer queries read a few frames late, so the CPU never waits on them.
+class DynamicResolution {
+  public:
+    ~DynamicResolution() { Destroy(); }
+
+    // targetGpuTime in seconds; scale stays within [minScale, 1]. GL context current.
+    bool Init(double targetGpuTime, float minScale);
+    void Destroy();
+
+    // Bind the scene framebuffer sized for a width x height output and start timing
+    void BeginScene(int width, int height);
+    // Stop timing and upscale the scene into target (0 = window back buffer)
+    void EndScene(GLuint target);
+
+    // A GPU time that completed since the last call, if any; feeds the controller
+    bool PollGpuTime(double &seconds);
+
+    float Scale() const { return scale; }
+
+  private:
+    static const int QUERY_COUNT = 4; // Frames in flight before a result is needed
+
+    void Resize(int width, int height);
+    void Adjust(double gpuTime);
+
+    double target = 0.0;
+    float minScale = 0.5f, scale = 1.0f;
+    double smoothed = 0.0; // Exponential moving average of GPU time
+    int cooldown = 0;      // Measurements to skip after a change so it can take effect first
+
+    GLuint fbo = 0, colorBuffer = 0, depthBuffer = 0;
+    int fboWidth = 0, fboHeight = 0;       // Allocated at full output size
+    int outputWidth = 0, outputHeight = 0; // Size of the frame being drawn
+    int sceneWidth = 0, sceneHeight = 0;   // Scaled region actually rendered
+
+    GLuint queries[QUERY_COUNT] = {};
+    bool queryPending[QUERY_COUNT] = {};
+    int nextQuery = 0;
+};
+
+#endif
@@ -1,83 +1,414 @@
 #include "Engine.h"
+#include "Log.h"
 #include "Renderer.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 
 // Global renderer instance
 Renderer renderer;
 
-Engine::Engine() : isRunning(false), window(nullptr) {}
+// Engine clock in seconds. Not glfwGetTime: headless runs never initialize GLFW.
+static double Now() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+Engine::Engine(const EngineConfig &config)
+    : config(config), isRunning(false), startupBegin(0.0), accumulator(0.0), previousTime(0.0), simRunning(false),
+      tickCount(0), redrawRequested(true), lastFrameAnimating(false), simWakeRequested(false), rateWindowStart(0.0),
+      ticksAtWindowStart(0), framesInWindow(0), measuredTickRate(0.0), measuredFrameRate(0.0) {}
 
 Engine::~Engine() { Shutdown(); }
 
+// Read a whole file, empty string when missing
+static std::string ReadFile(const std::string &path) {
+    std::string text;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return text;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) text.append(buffer, n);
+    fclose(file);
+    return text;
+}
+
+// CPU-side startup work handed to the job system, and how long each piece took
+struct StartupLoad {
+    std::string shaderDir;
+    double shaderTime = 0.0, meshTime = 0.0;
+};
+
 bool Engine::Initialize() {
-    if (!glfwInit()) {
-        std::cerr << "GLFW init failed\n";
+    startupBegin = Now();
+
+    // With no tick length the accumulator never drains and the simulation silently stops
+    if (!(config.tickRate > 0.0) || config.maxCatchUpTicks < 1) {
+        LOG_ERROR("tickRate must be positive and maxCatchUpTicks at least 1");
         return false;
     }
 
-    window = glfwCreateWindow(800, 600, "Mini Game Engine", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "GLFW window creation failed\n";
-        glfwTerminate();
-        return false;
+    // Workers come up first so startup work can already fan out
+    jobs.Start(config.workerThreads);
+    frameArena.Init(config.frameArenaBytes);
+    physics.SetJobSystem(&jobs);
+    if (config.physicsDemo > 0) SpawnPhysicsDemo(config.physicsDemo);
+    softBodies.SetJobSystem(&jobs);
+    if (config.clothDemo > 0) {
+        SpawnClothDrape(softBodies, static_cast<uint32_t>(config.clothDemo));
+        LOG_INFO("Cloth demo: {}x{} particles", config.clothDemo, config.clothDemo);
+    }
+    fluid.SetJobSystem(&jobs);
+    if (config.fluidDemo > 0) {
+        SpawnDamBreak(fluid, static_cast<uint32_t>(config.fluidDemo));
+        LOG_INFO("Fluid demo: {} particles", config.fluidDemo);
     }
 
-    glfwMakeContextCurrent(window);
-    glewExperimental = GL_TRUE;
+    // Startup dependency graph. Only the context and GL work are tied to this thread, so
+    // everything else runs on workers while the window comes up:
+    //
+    //   read shader sources  --+
+    //   build grid/axes mesh --+--> GPU upload --> first frame
+    //   display + GL loader  --+
+    StartupLoad load;
+    load.shaderDir = config.shaderDir;
+    Job loadJobs[2];
+    loadJobs[0].data = loadJobs[1].data = &load;
+    loadJobs[0].function = [](const Job &job) {
+        StartupLoad &load = *static_cast<StartupLoad *>(job.data);
+        double start = Now();
+        renderer.SetShaderSources(ReadFile(load.shaderDir + "/basic.vert"), ReadFile(load.shaderDir + "/basic.frag"));
+        load.shaderTime = Now() - start;
+    };
+    loadJobs[1].function = [](const Job &job) {
+        StartupLoad &load = *static_cast<StartupLoad *>(job.data);
+        double start = Now();
+        renderer.BuildMeshes();
+        load.meshTime = Now() - start;
+    };
+    JobCounter loaded;
+    jobs.Run(loadJobs, 2, &loaded);
 
-    if (glewInit() != GLEW_OK) {
-        std::cerr << "GLEW init failed\n";
-        return false;
-    }
+    bool contextReady = CreateContext();
+    double contextTime = Now() - startupBegin;
+
+    // The load jobs point at this frame's locals, so join them even when the context failed
+    jobs.Wait(loaded);
+    if (!contextReady) return false;
 
     glEnable(GL_DEPTH_TEST);
 
-    // Renderer init (setup VAOs for axes & grid)
-    renderer.Init();
+    double uploadStart = Now();
+    renderer.Upload();
+    if (config.targetGpuTime > 0.0) dynamicResolution.Init(config.targetGpuTime, config.minRenderScale);
 
+    LOG_INFO("{} display {}x{}, OpenGL {}, {} job workers", config.display, config.width, config.height,
+             reinterpret_cast<const char *>(glGetString(GL_VERSION)), jobs.WorkerCount());
+    LOG_INFO("Startup: context {} ms, shaders read {} ms, meshes {} ms (in parallel), upload {} ms",
+             contextTime * 1000.0, load.shaderTime * 1000.0, load.meshTime * 1000.0, (Now() - uploadStart) * 1000.0);
     return true;
 }
 
-void Engine::Run() {
-    if (!Initialize()) return;
+// Window/surface, GL context and entry points; has to happen on the main thread
+bool Engine::CreateContext() {
+    display.reset(CreateDisplay(config.display));
+    if (!display) {
+        LOG_ERROR("Unknown or unsupported display backend: {}", config.display);
+        return false;
+    }
+    if (!display->Create(config.width, config.height, "Mini Game Engine", config.vsync)) return false;
+    display->SetActivityCallback([](void *engine) { static_cast<Engine *>(engine)->RequestRedraw(); }, this);
+
+    glewExperimental = GL_TRUE;
+
+    // Without GLX (EGL/OSMesa contexts) glewInit reports an error after loading the GL entry points;
+    // glewContextInit loads just those
+    if (glewInit() != GLEW_OK && glewContextInit() != GLEW_OK) {
+        LOG_ERROR("GLEW init failed");
+        return false;
+    }
+
+    return display->OnGlLoaded();
+}
+
+bool Engine::Run() {
+    if (!Initialize()) return false;
 
     isRunning = true;
 
-    while (!glfwWindowShouldClose(window)) {
+    // Fixed-step simulation, free-running render: real time is fed into an accumulator
+    // and drained in whole ticks. Each tick is published as a snapshot holding the last two
+    // ticks; Render gets the newest one and alpha, how far real time has run past its last tick.
+    const double dt = 1.0 / config.tickRate;
+    const double minFrameTime = config.maxFrameRate > 0.0 ? 1.0 / config.maxFrameRate : 0.0;
+    accumulator = 0.0;
+    previousTime = Now();
+    rateWindowStart = previousTime;
+    PublishTick(previousTime);
+
+    if (!stats.Open(config.statsCsv, config.statsInterval, previousTime))
+        LOG_ERROR("Cannot write frame stats to {}", config.statsCsv);
+
+    if (config.pipelined) {
+        simRunning = true;
+        simThread = std::thread(&Engine::SimulationLoop, this);
+    }
+
+    int frameNumber = 0;
+    bool dumped = true;
+    while (!display->ShouldClose()) {
+        // On-demand mode: nothing moving and nothing dirty means block in the event queue
+        // instead of redrawing an unchanged scene
+        if (config.onDemand && !NeedsFrame()) {
+            display->WaitEvents(config.idleTimeout);
+            ProcessInput();
+            jobs.PumpMainThread();
+            if (!NeedsFrame()) continue;
+            if (!config.pipelined) ResumeTicks();
+        }
+
+        double frameStart = Now();
+        uint64_t allocationsAtStart = MemTotalAllocations();
+        bool lastFrame = config.maxFrames > 0 && frameNumber + 1 >= config.maxFrames;
+
         ProcessInput();
-        Update();
-        Render();
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        jobs.PumpMainThread();
+        if (!config.pipelined) RunTicks(frameStart);
+
+        frames.Acquire();
+        const FrameSnapshot &frame = frames.ReadBuffer();
+        float alpha = static_cast<float>(std::min(1.0, std::max(0.0, (frameStart - frame.tickTime) / dt)));
+
+        lastFrameAnimating = frame.current.animating;
+
+        double renderStart = Now();
+        Render(frame, alpha);
+        if (lastFrame && !config.dumpFrame.empty()) dumped = DumpLastFrame();
+        double swapStart = Now();
+        display->SwapBuffers();
+        double swapEnd = Now();
+        display->PollEvents();
+
+        if (lastFrame) display->RequestClose();
+        if (frameNumber == 0) LOG_INFO("Time to first frame: {} ms", (swapEnd - startupBegin) * 1000.0);
+        frameNumber++;
+
+        if (config.targetGpuTime > 0.0) {
+            double gpuTime;
+            if (dynamicResolution.PollGpuTime(gpuTime)) stats.RecordGpu(gpuTime);
+            stats.RecordRenderScale(dynamicResolution.Scale());
+        }
+
+        double frameEnd = Now();
+        frameArena.Reset();
+        stats.EndFrame(frameEnd - frameStart, swapStart - renderStart, swapEnd - swapStart,
+                       MemTotalAllocations() - allocationsAtStart, frameEnd);
+        UpdateRateCounters(frameEnd);
+
+        if (minFrameTime > 0.0) {
+            double remaining = minFrameTime - (Now() - frameStart);
+            if (remaining > 0.0) std::this_thread::sleep_for(std::chrono::duration<double>(remaining));
+        }
     }
 
     Shutdown();
+    return dumped;
+}
+
+int Engine::RunTicks(double now) {
+    const double dt = 1.0 / config.tickRate;
+    accumulator += now - previousTime;
+    previousTime = now;
+
+    int ticks = 0;
+    while (accumulator >= dt && ticks < config.maxCatchUpTicks) {
+        double updateStart = Now();
+        Update(dt);
+        stats.RecordUpdate(Now() - updateStart);
+        accumulator -= dt;
+        ++ticks;
+        PublishTick(now - accumulator);
+    }
+    // Still behind after the catch-up budget: drop the backlog instead of spiralling
+    if (accumulator >= dt) accumulator = 0.0;
+    return ticks;
+}
+
+void Engine::PublishTick(double tickTime) {
+    FrameSnapshot &snapshot = frames.WriteBuffer();
+    snapshot.previous = lastPublished;
+    snapshot.current = state;
+    snapshot.tickTime = tickTime;
+    frames.Publish();
+
+    lastPublished = state;
+    tickCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Engine::SimulationLoop() {
+    // Own a job deque so Update can fan work out without locks
+    jobs.RegisterThread();
+
+    const double dt = 1.0 / config.tickRate;
+    while (simRunning.load(std::memory_order_acquire)) {
+        RunTicks(Now());
+
+        // On-demand mode with a static scene: park until something asks for a redraw
+        if (config.onDemand && !state.animating) {
+            std::unique_lock<std::mutex> lock(simWakeLock);
+            simWake.wait(lock, [&] { return simWakeRequested || !simRunning.load(std::memory_order_acquire); });
+            simWakeRequested = false;
+            lock.unlock();
+            ResumeTicks();
+            continue;
+        }
+
+        // Sleep until the next tick is due
+        double wait = dt - accumulator;
+        if (wait > 0.0) std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+    }
+}
+
+void Engine::RequestRedraw() {
+    redrawRequested.store(true, std::memory_order_release);
+    if (display) display->Wake();
+    if (config.onDemand && config.pipelined) {
+        std::lock_guard<std::mutex> lock(simWakeLock);
+        simWakeRequested = true;
+        simWake.notify_one();
+    }
+}
+
+bool Engine::NeedsFrame() {
+    if (redrawRequested.exchange(false, std::memory_order_acq_rel)) return true;
+    // Keep drawing while the last snapshot was moving, or a newer one is waiting
+    return lastFrameAnimating || frames.HasFresh();
+}
+
+void Engine::ResumeTicks() {
+    previousTime = Now();
+    accumulator = 0.0;
 }
 
 void Engine::ProcessInput() {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) glfwSetWindowShouldClose(window, true);
+    if (display->IsKeyDown(GLFW_KEY_ESCAPE)) display->RequestClose();
 }
 
-void Engine::Update() {
-    // Placeholder for physics or logic update
+void Engine::Update(double dt) {
+    physics.Step(static_cast<Real>(dt));
+    softBodies.Step(static_cast<Real>(dt));
+    fluid.Step(static_cast<Real>(dt));
+
+    state.tick++;
+    state.simTime += dt;
+    // Sleeping bodies do not need redraws; soft bodies and fluids never sleep
+    state.animating = physics.AwakeBodyCount() > 0 || softBodies.ParticleCount() > 0 || fluid.ParticleCount() > 0;
 }
 
-void Engine::Render() {
+// Stress scene for --physics-demo: a ground plane and a loose column of mixed spheres and boxes
+// falling onto it, count bodies in layers of 10x10
+void Engine::SpawnPhysicsDemo(int count) {
+    physics.Reserve(count + 1);
+
+    BodyDesc ground;
+    ground.shape = ShapeType::Plane;
+    physics.AddBody(ground);
+
+    for (int i = 0; i < count; ++i) {
+        int layer = i / 100, row = (i / 10) % 10, column = i % 10;
+        BodyDesc body;
+        body.shape = (i + layer) % 2 ? ShapeType::Box : ShapeType::Sphere;
+        body.position = Vec3((column - 4.5f) * 1.1f + (layer % 2) * 0.3f, 1.0f + layer * 1.2f, (row - 4.5f) * 1.1f);
+        body.radius = 0.5f;
+        body.halfExtents = Vec3(0.5f, 0.4f, 0.5f);
+        physics.AddBody(body);
+    }
+    LOG_INFO("Physics demo: {} bodies", count);
+}
+
+void Engine::Render(const FrameSnapshot &frame, float alpha) {
+    // Only the grid and axes are drawn, and nothing in them comes from the simulation, so frame and
+    // alpha go unused. Simulated objects, once drawn, blend frame.previous and frame.current by alpha.
+    (void)frame;
+    (void)alpha;
+
+    // Headless backends draw into their own FBO
+    int width, height;
+    display->GetFramebufferSize(width, height);
+    GLuint target = display->TargetFramebuffer();
+    bool scaled = config.targetGpuTime > 0.0;
+    if (scaled) {
+        dynamicResolution.BeginScene(width, height);
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, target);
+        glViewport(0, 0, width, height);
+    }
+
     glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // Draw coordinate axes and grid
     renderer.RenderAxes();
     renderer.RenderGrid();
+
+    if (scaled) dynamicResolution.EndScene(target);
+}
+
+void Engine::UpdateRateCounters(double now) {
+    framesInWindow++;
+
+    double elapsed = now - rateWindowStart;
+    if (elapsed < 1.0) return;
+
+    uint64_t ticks = tickCount.load(std::memory_order_relaxed);
+    measuredTickRate = (ticks - ticksAtWindowStart) / elapsed;
+    measuredFrameRate = framesInWindow / elapsed;
+    ticksAtWindowStart = ticks;
+    framesInWindow = 0;
+    rateWindowStart = now;
+
+    char title[128];
+    snprintf(title, sizeof(title), "Mini Game Engine - %.0f fps / %.0f ticks/s", measuredFrameRate, measuredTickRate);
+    display->SetTitle(title);
+}
+
+bool Engine::DumpLastFrame() {
+    int width, height;
+    display->GetFramebufferSize(width, height);
+    unsigned long long hash = 0;
+    if (!DumpFramebuffer(display->TargetFramebuffer(), width, height, config.dumpFrame, hash)) {
+        LOG_ERROR("Cannot write frame to {}", config.dumpFrame);
+        return false;
+    }
+    printf("Frame written to %s (%dx%d, fnv1a %016llx)\n", config.dumpFrame.c_str(), width, height, hash);
+    return true;
 }
 
 void Engine::Shutdown() {
-    if (window) {
-        glfwDestroyWindow(window);
-        window = nullptr;
+    // The sim thread may still be mid-tick; stop it before the window goes away
+    if (simThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(simWakeLock);
+            simRunning = false;
+            simWake.notify_one();
+        }
+        simThread.join();
+    }
+    jobs.Stop();
+
+    if (isRunning) {
+        stats.ReportTotal(Now());
+        stats.Close();
+        MemReport();
+        isRunning = false;
+    }
+
+    if (display) {
+        dynamicResolution.Destroy();
+        display->Destroy();
+        display.reset();
     }
-    glfwTerminate();
 }
@@ -1,22 +1,137 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include "Display.h"
+#include "DynamicResolution.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+#include "Memory.h"
+#include "Fluid.h"
+#include "Physics.h"
+#include "SoftBody.h"
+#include "SceneState.h"
+#include "TripleBuffer.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Startup options, filled from the command line in main.cpp
+struct EngineConfig {
+    double tickRate = 60.0;    // Fixed simulation ticks per second
+    int maxCatchUpTicks = 5;   // Ticks allowed per frame before the loop drops time
+    double maxFrameRate = 0.0; // Render rate cap in frames per second, 0 = uncapped
+    bool vsync = true;         // Sync buffer swaps to the display
+    bool pipelined = true;     // Simulate on a separate thread while the main thread renders
+    int workerThreads = -1;    // Job system workers, -1 = one per spare hardware thread
+    double statsInterval = 10; // Seconds between frame-time reports, 0 = only at shutdown
+    std::string statsCsv;      // Per-frame timings written here when set
+
+    std::string display = "glfw"; // "glfw" window, or offscreen "egl" / "osmesa"
+    int width = 800, height = 600;
+    int maxFrames = 0;     // Stop after this many frames, 0 = run until closed
+    std::string dumpFrame; // Write the last frame here as PPM (needs maxFrames)
+
+    bool onDemand = false;    // Only redraw on input, resize or a dirty scene; sleep otherwise
+    double idleTimeout = 0.5; // Longest on-demand sleep before re-checking, seconds
+
+    std::string logFile; // Log here instead of stderr
+
+    std::string shaderDir = "shaders"; // basic.vert / basic.frag are read from here at startup
+    size_t frameArenaBytes = 4 << 20;  // Per-frame scratch memory, see FrameArena
+
+    double targetGpuTime = 0.0; // Dynamic resolution target for the scene pass in seconds, 0 = always full size
+    float minRenderScale = 0.5f;
+
+    int physicsDemo = 0; // Bodies dropped onto a ground plane at startup, 0 = empty world
+    int clothDemo = 0;   // Resolution of a cloth draped over the grid at startup, 0 = none
+    int fluidDemo = 0;   // Particles in a dam break at startup, 0 = none
+};
+
 class Engine {
   public:
-    Engine();
+    Engine(const EngineConfig &config = EngineConfig());
     ~Engine();
 
-    void Run(); // Main loop
+    bool Run(); // Main loop, false if startup or --dump-frame failed
+
+    double GetMeasuredTickRate() const { return measuredTickRate; }
+    double GetMeasuredFrameRate() const { return measuredFrameRate; }
+    JobSystem &GetJobs() { return jobs; }
+    FrameArena &GetFrameArena() { return frameArena; } // Scratch memory valid until the end of the frame
+    PhysicsWorld &GetPhysics() { return physics; }     // Simulation side only, see state below
+    SoftBodyWorld &GetSoftBodies() { return softBodies; }
+    FluidWorld &GetFluid() { return fluid; }
+
+    // Mark the scene dirty so the next frame is drawn even in on-demand mode. Any thread.
+    void RequestRedraw();
 
   private:
-    bool Initialize();   // Init OpenGL, window etc.
-    void ProcessInput(); // Handle keyboard etc.
-    void Update();       // Physics and logic
-    void Render();       // Draw objects, grid, etc.
-    void Shutdown();     // Cleanup
+    bool Initialize();                                    // Init OpenGL, window etc.
+    bool CreateContext();                                 // Display, GL context and loader
+    void ProcessInput();                                  // Handle keyboard etc.
+    void Update(double dt);                               // Physics and logic, one fixed tick
+    void Render(const FrameSnapshot &frame, float alpha); // Draw objects, grid, etc. from a published snapshot
+    void Shutdown();                                      // Cleanup
+
+    int RunTicks(double now);          // Drain the accumulator in fixed ticks, publishing each one
+    void PublishTick(double tickTime); // Hand the current state to the renderer
+    void SimulationLoop();             // Body of the simulation thread in pipelined mode
+    void UpdateRateCounters(double now);
+    bool DumpLastFrame(); // --dump-frame: write the target framebuffer out before it is presented
+    bool NeedsFrame();    // On-demand mode: is there anything to draw?
+    void ResumeTicks();   // Restart the tick clock after idling so the sim does not catch up the idle time
+    void SpawnPhysicsDemo(int count);
 
+    EngineConfig config;
     bool isRunning;
-    struct GLFWwindow *window;
+    double startupBegin; // For the time-to-first-frame report
+    std::unique_ptr<Display> display;
+
+    // One scheduler for every subsystem that wants more than one core
+    JobSystem jobs;
+
+    // Frame, update, render and swap time percentiles
+    FrameStats stats;
+
+    // Reset at the end of every main loop iteration
+    FrameArena frameArena;
+
+    // Scene resolution scaling when config.targetGpuTime is set
+    DynamicResolution dynamicResolution;
+
+    // Simulation side: owned by the sim thread in pipelined mode, the main thread otherwise
+    SceneState state;
+    SceneState lastPublished;
+    PhysicsWorld physics;     // Stepped once per tick from Update
+    SoftBodyWorld softBodies; // Cloth and soft volumes, stepped after physics
+    FluidWorld fluid;         // Stepped last
+    double accumulator, previousTime;
+
+    // Sim to render handoff. The sim thread writes a snapshot per tick, the render thread
+    // picks up the newest one each frame; neither waits for the other.
+    TripleBuffer<FrameSnapshot> frames;
+    std::thread simThread;
+    std::atomic<bool> simRunning;
+    std::atomic<uint64_t> tickCount;
+
+    // On-demand rendering: redraw requests from input callbacks or game code, and the
+    // parked simulation thread's wake-up signal
+    std::atomic<bool> redrawRequested;
+    bool lastFrameAnimating;
+    std::mutex simWakeLock;
+    std::condition_variable simWake;
+    bool simWakeRequested;
+
+    // Tick and frame rates measured over the last second
+    double rateWindowStart;
+    uint64_t ticksAtWindowStart;
+    int framesInWindow;
+    double measuredTickRate, measuredFrameRate;
 };
 
 #endif
@@ -0,0 +1,167 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <cstdint>
+
+// Signed 40.24 fixed-point number, the physics scalar in PHYSICS_FIXED_POINT builds.
+//
+// Everything is integer arithmetic with one rounding rule per operation: products round to
+// nearest (halves away from zero), quotients and square roots truncate. A simulation therefore
+// gives bit-identical results on every machine and compiler. Sums, products and quotients
+// saturate instead of overflowing. Converting from float is exact up to that same rounding, so equal float
+// inputs always give equal values.
+class Fixed {
+  public:
+    static constexpr int FRACTION_BITS = 24;
+
+    constexpr Fixed() : raw(0) {}
+    constexpr Fixed(int value) : raw(static_cast<int64_t>(value) * ONE) {}
+    Fixed(float value) : raw(FromDouble(value)) {}
+    Fixed(double value) : raw(FromDouble(value)) {}
+
+    static constexpr Fixed FromRaw(int64_t raw) { return Fixed(raw, RawTag()); }
+    constexpr int64_t Raw() const { return raw; }
+    explicit operator float() const { return static_cast<float>(static_cast<double>(raw) / ONE); }
+    explicit operator double() const { return static_cast<double>(raw) / ONE; }
+
+    Fixed operator-() const { return FromRaw(Signed(Magnitude(raw), raw > 0)); }
+    friend Fixed operator+(Fixed a, Fixed b) { return FromRaw(Add(a.raw, b.raw)); }
+    friend Fixed operator-(Fixed a, Fixed b) { return a + -b; }
+    friend Fixed operator*(Fixed a, Fixed b) { return FromRaw(Multiply(a.raw, b.raw)); }
+    friend Fixed operator/(Fixed a, Fixed b) { return FromRaw(Divide(a.raw, b.raw)); }
+    Fixed &operator+=(Fixed o) { return *this = *this + o; }
+    Fixed &operator-=(Fixed o) { return *this = *this - o; }
+    Fixed &operator*=(Fixed o) { return *this = *this * o; }
+    Fixed &operator/=(Fixed o) { return *this = *this / o; }
+
+    friend bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
+    friend bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
+    friend bool operator<(Fixed a, Fixed b) { return a.raw < b.raw; }
+    friend bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+    friend bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
+    friend bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
+
+    // Truncated square root, 0 for negative input
+    friend Fixed Sqrt(Fixed x) {
+        if (x.raw <= 0) return Fixed();
+        return FromRaw(static_cast<int64_t>(SquareRoot(Shifted(static_cast<uint64_t>(x.raw)))));
+    }
+
+  private:
+    static constexpr int64_t ONE = int64_t(1) << FRACTION_BITS;
+    static constexpr uint64_t MAX_MAGNITUDE = 0x7fffffffffffffffull;
+
+    struct RawTag {};
+    constexpr Fixed(int64_t raw, RawTag) : raw(raw) {}
+
+    static int64_t FromDouble(double value) {
+        double scaled = value * static_cast<double>(ONE);
+        if (scaled >= 9.2e18) return static_cast<int64_t>(MAX_MAGNITUDE);
+        if (scaled <= -9.2e18) return -static_cast<int64_t>(MAX_MAGNITUDE);
+        return static_cast<int64_t>(scaled < 0.0 ? scaled - 0.5 : scaled + 0.5);
+    }
+
+    static uint64_t Magnitude(int64_t v) { return v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v); }
+    static int64_t Signed(uint64_t magnitude, bool negative) {
+        if (magnitude > MAX_MAGNITUDE) magnitude = MAX_MAGNITUDE;
+        return negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+    }
+
+    // 128-bit unsigned intermediate. The compiler's when it has one, otherwise two halves; both give
+    // the same results, FIXED_POINT_NO_INT128 forces the fallback to check that.
+#if defined(__SIZEOF_INT128__) && !defined(FIXED_POINT_NO_INT128)
+    typedef unsigned __int128 Wide;
+    static Wide Product(uint64_t a, uint64_t b) { return static_cast<Wide>(a) * b; }
+    static Wide Shifted(uint64_t a) { return static_cast<Wide>(a) << FRACTION_BITS; }
+    static uint64_t High(Wide w) { return static_cast<uint64_t>(w >> 64); }
+    static uint64_t Low(Wide w) { return static_cast<uint64_t>(w); }
+    static Wide Make(uint64_t high, uint64_t low) { return (static_cast<Wide>(high) << 64) | low; }
+#else
+    struct Wide {
+        uint64_t high, low;
+
+        Wide operator+(const Wide &o) const {
+            uint64_t sum = low + o.low;
+            return Wide{high + o.high + (sum < low ? 1 : 0), sum};
+        }
+        Wide operator-(const Wide &o) const { return Wide{high - o.high - (low < o.low ? 1 : 0), low - o.low}; }
+        Wide operator>>(int n) const {
+            if (n == 0) return *this;
+            if (n >= 64) return Wide{0, high >> (n - 64)};
+            return Wide{high >> n, (low >> n) | (high << (64 - n))};
+        }
+        bool operator<(const Wide &o) const { return high != o.high ? high < o.high : low < o.low; }
+        bool operator>=(const Wide &o) const { return !(*this < o); }
+        bool operator!=(const Wide &o) const { return high != o.high || low != o.low; }
+    };
+    static Wide Product(uint64_t a, uint64_t b) {
+        uint64_t a0 = a & 0xffffffffu, a1 = a >> 32, b0 = b & 0xffffffffu, b1 = b >> 32;
+        uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+        uint64_t middle = (p00 >> 32) + (p01 & 0xffffffffu) + (p10 & 0xffffffffu);
+        return Wide{p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32), (middle << 32) | (p00 & 0xffffffffu)};
+    }
+    static Wide Shifted(uint64_t a) { return Wide{a >> (64 - FRACTION_BITS), a << FRACTION_BITS}; }
+    static uint64_t High(const Wide &w) { return w.high; }
+    static uint64_t Low(const Wide &w) { return w.low; }
+    static Wide Make(uint64_t high, uint64_t low) { return Wide{high, low}; }
+#endif
+
+    // Checked before adding, since signed overflow is undefined
+    static int64_t Add(int64_t a, int64_t b) {
+        const int64_t limit = static_cast<int64_t>(MAX_MAGNITUDE);
+        if (b > 0 && a > limit - b) return limit;
+        if (b < 0 && a < -limit - b) return -limit;
+        return a + b;
+    }
+
+    static int64_t Multiply(int64_t a, int64_t b) {
+        Wide product = Product(Magnitude(a), Magnitude(b)) + Make(0, uint64_t(1) << (FRACTION_BITS - 1));
+        Wide shifted = product >> FRACTION_BITS;
+        uint64_t magnitude = High(shifted) ? ~uint64_t(0) : Low(shifted);
+        return Signed(magnitude, (a < 0) != (b < 0));
+    }
+
+    // (a << FRACTION_BITS) / b; the fallback is restoring division, one quotient bit per step
+    static int64_t Divide(int64_t a, int64_t b) {
+        bool negative = (a < 0) != (b < 0);
+        uint64_t divisor = Magnitude(b);
+        Wide dividend = Shifted(Magnitude(a));
+        if (divisor == 0 || High(dividend) >= divisor) return a == 0 ? 0 : Signed(~uint64_t(0), negative);
+#if defined(__SIZEOF_INT128__) && !defined(FIXED_POINT_NO_INT128)
+        return Signed(static_cast<uint64_t>(dividend / divisor), negative);
+#else
+        uint64_t remainder = High(dividend), low = Low(dividend), quotient = 0;
+        for (int bit = 63; bit >= 0; --bit) {
+            bool carry = (remainder >> 63) != 0;
+            remainder = (remainder << 1) | ((low >> bit) & 1u);
+            quotient <<= 1;
+            if (carry || remainder >= divisor) {
+                remainder -= divisor;
+                quotient |= 1u;
+            }
+        }
+        return Signed(quotient, negative);
+#endif
+    }
+
+    // Bit-by-bit integer square root; n < 2^87, so the root fits in 44 bits
+    static uint64_t SquareRoot(Wide n) {
+        Wide root = Make(0, 0), bit = Make(uint64_t(1) << 22, 0); // 2^86
+        while (n < bit) bit = bit >> 2;
+        while (bit != Make(0, 0)) {
+            Wide trial = root + bit;
+            if (n >= trial) {
+                n = n - trial;
+                root = (root >> 1) + bit;
+            } else {
+                root = root >> 1;
+            }
+            bit = bit >> 2;
+        }
+        return Low(root);
+    }
+
+    int64_t raw;
+};
+
+#endif
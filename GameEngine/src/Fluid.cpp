@@ -0,0 +1,352 @@
+#include "Fluid.h"
+#include "JobSystem.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+// Fixed-point builds stay scalar: the SSE paths are float only
+#if defined(__SSE2__) && !defined(PHYSICS_FIXED_POINT)
+#include <emmintrin.h>
+#define PHYSICS_SSE 1
+#endif
+
+static double Seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const uint32_t PARTICLE_GRAIN = 1024; // Particles per job in the neighbour passes
+static const uint32_t COLUMN_GRAIN = 16384;  // Particles per job for per-particle copies
+static const Real PI = 3.14159265f;
+
+// Kernels (Mueller et al. 2003) in terms of q = r / h, so no power of h is ever formed.
+// W_poly6 = POLY6 / h^3 * (1 - q^2)^3, grad W_spiky = -SPIKY / h^4 * (1 - q)^2 along r,
+// laplacian W_viscosity = VISCOSITY / h^5 * (1 - q).
+static const Real POLY6 = Real(315) / (Real(64) * PI);
+static const Real SPIKY = Real(45) / PI;
+static const Real VISCOSITY_KERNEL = Real(45) / PI;
+
+FluidWorld::FluidWorld(const FluidConfig &config) : config(config) {
+    // Particle mass that puts a particle inside the spawn lattice exactly at rest density
+    const Real h = config.smoothingRadius, spacing = h * Real(0.5f);
+    Real sum = Real(0);
+    for (int z = -2; z <= 2; ++z) {
+        for (int y = -2; y <= 2; ++y) {
+            for (int x = -2; x <= 2; ++x) {
+                Real q2 = Real(x * x + y * y + z * z) * spacing * spacing / (h * h);
+                if (q2 < Real(1)) sum += (Real(1) - q2) * (Real(1) - q2) * (Real(1) - q2);
+            }
+        }
+    }
+    particleMass = config.restDensity * h * h * h / (POLY6 * sum);
+    SetContainer(Aabb{Vec3(-1, 0, -1), Vec3(1, 2, 1)});
+}
+
+template <typename F> void FluidWorld::ParallelFor(uint32_t count, uint32_t grain, const F &fn) const {
+    if (jobs) {
+        jobs->ParallelFor(count, grain, fn);
+        return;
+    }
+    for (uint32_t begin = 0; begin < count; begin += grain) fn(begin, std::min(begin + grain, count));
+}
+
+// ---- Particles ----
+
+void FluidWorld::SetContainer(const Aabb &box) {
+    if (!px.empty()) LOG_WARN("Fluid container changed with particles in it");
+    container = box;
+    inverseCellSize = Real(1) / config.smoothingRadius;
+    Vec3 extent = (box.max - box.min) * inverseCellSize;
+    gridX = std::max(1, static_cast<int32_t>(std::ceil(static_cast<float>(extent.x))));
+    gridY = std::max(1, static_cast<int32_t>(std::ceil(static_cast<float>(extent.y))));
+    gridZ = std::max(1, static_cast<int32_t>(std::ceil(static_cast<float>(extent.z))));
+    cellStart.assign(static_cast<size_t>(gridX) * gridY * gridZ + 1, 0);
+}
+
+void FluidWorld::AddParticle(const Vec3 &position, const Vec3 &velocity) {
+    Vec3 p = Min(Max(position, container.min), container.max);
+    px.push_back(p.x), py.push_back(p.y), pz.push_back(p.z);
+    vx.push_back(velocity.x), vy.push_back(velocity.y), vz.push_back(velocity.z);
+    ax.push_back(Real(0)), ay.push_back(Real(0)), az.push_back(Real(0));
+    density.push_back(config.restDensity);
+    pressureTerm.push_back(Real(0));
+}
+
+uint32_t FluidWorld::AddBlock(const Aabb &region, const Vec3 &velocity) {
+    const Real spacing = config.smoothingRadius * Real(0.5f);
+    uint32_t added = 0;
+    for (Real z = region.min.z + spacing * Real(0.5f); z < region.max.z; z += spacing) {
+        for (Real y = region.min.y + spacing * Real(0.5f); y < region.max.y; y += spacing) {
+            for (Real x = region.min.x + spacing * Real(0.5f); x < region.max.x; x += spacing) {
+                AddParticle(Vec3(x, y, z), velocity);
+                added++;
+            }
+        }
+    }
+    return added;
+}
+
+void FluidWorld::Clear() {
+    for (auto *column : {&px, &py, &pz, &vx, &vy, &vz, &ax, &ay, &az, &density, &pressureTerm, &scratch})
+        column->clear();
+    cell.clear();
+    order.clear();
+    stats = FluidStats();
+}
+
+// ---- Grid ----
+
+void FluidWorld::GridCoords(uint32_t i, int32_t &x, int32_t &y, int32_t &z) const {
+    x = static_cast<int32_t>(static_cast<float>((px[i] - container.min.x) * inverseCellSize));
+    y = static_cast<int32_t>(static_cast<float>((py[i] - container.min.y) * inverseCellSize));
+    z = static_cast<int32_t>(static_cast<float>((pz[i] - container.min.z) * inverseCellSize));
+    x = std::min(std::max(x, 0), gridX - 1);
+    y = std::min(std::max(y, 0), gridY - 1);
+    z = std::min(std::max(z, 0), gridZ - 1);
+}
+
+// Counting sort by cell, then every column is moved into cell order
+void FluidWorld::SortByCell() {
+    const uint32_t n = static_cast<uint32_t>(px.size());
+    cell.resize(n);
+    order.resize(n);
+    scratch.resize(n);
+    ParallelFor(n, COLUMN_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            int32_t x, y, z;
+            GridCoords(i, x, y, z);
+            cell[i] = static_cast<uint32_t>((z * gridY + y) * gridX + x);
+        }
+    });
+
+    // Histogram and prefix sum are a few operations per particle and stay serial
+    std::fill(cellStart.begin(), cellStart.end(), 0);
+    for (uint32_t i = 0; i < n; ++i) cellStart[cell[i] + 1]++;
+    for (size_t c = 1; c < cellStart.size(); ++c) cellStart[c] += cellStart[c - 1];
+    for (uint32_t i = 0; i < n; ++i) order[i] = cellStart[cell[i]]++;
+    // Each start was advanced to the next cell's; shift back
+    for (size_t c = cellStart.size() - 1; c > 0; --c) cellStart[c] = cellStart[c - 1];
+    cellStart[0] = 0;
+
+    for (auto *column : {&px, &py, &pz, &vx, &vy, &vz}) {
+        ParallelFor(n, COLUMN_GRAIN, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i) scratch[order[i]] = (*column)[i];
+        });
+        column->swap(scratch);
+    }
+}
+
+template <typename F> void FluidWorld::ForEachNeighborRun(uint32_t i, const F &f) const {
+    // cell[] is indexed by the slot before sorting, so the cell is found again from the position
+    int32_t x, y, z;
+    GridCoords(i, x, y, z);
+    const int32_t x0 = std::max(x - 1, 0), x1 = std::min(x + 1, gridX - 1);
+    for (int32_t cz = std::max(z - 1, 0); cz <= std::min(z + 1, gridZ - 1); ++cz) {
+        for (int32_t cy = std::max(y - 1, 0); cy <= std::min(y + 1, gridY - 1); ++cy) {
+            const int32_t row = (cz * gridY + cy) * gridX;
+            f(cellStart[row + x0], cellStart[row + x1 + 1]);
+        }
+    }
+}
+
+// ---- Step ----
+
+void FluidWorld::Step(Real dt) {
+    stats.particles = static_cast<uint32_t>(px.size());
+    stats.cells = static_cast<uint32_t>(cellStart.size() - 1);
+    stats.sortTime = stats.densityTime = stats.forceTime = stats.integrateTime = 0.0;
+    if (px.empty() || dt <= Real(0) || config.substeps < 1) return;
+
+    const Real h = dt / Real(config.substeps);
+    for (int substep = 0; substep < config.substeps; ++substep) {
+        double start = Seconds();
+        SortByCell();
+        double sorted = Seconds();
+        ComputeDensity();
+        double densities = Seconds();
+        ComputeForces();
+        double forces = Seconds();
+        Integrate(h);
+
+        stats.sortTime += sorted - start;
+        stats.densityTime += densities - sorted;
+        stats.forceTime += forces - densities;
+        stats.integrateTime += Seconds() - forces;
+    }
+}
+
+// Density from the poly6 kernel, then the equation of state. Pressure is clamped at zero: the
+// tension a negative pressure would add clumps particles at free surfaces.
+void FluidWorld::ComputeDensity() {
+    const Real h = config.smoothingRadius, inverseH2 = Real(1) / (h * h), scale = particleMass * POLY6 / (h * h * h);
+    const Real *x = px.data(), *y = py.data(), *z = pz.data();
+    std::atomic<uint64_t> neighbors(0);
+    ParallelFor(static_cast<uint32_t>(px.size()), PARTICLE_GRAIN, [&](uint32_t begin, uint32_t end) {
+        uint64_t found = 0;
+        for (uint32_t i = begin; i < end; ++i) {
+            const Real xi = x[i], yi = y[i], zi = z[i];
+            Real sum = Real(0);
+            uint32_t count = 0;
+#ifdef PHYSICS_SSE
+            const __m128 cx = _mm_set1_ps(xi), cy = _mm_set1_ps(yi), cz = _mm_set1_ps(zi);
+            const __m128 one = _mm_set1_ps(1.0f), scaleQ = _mm_set1_ps(inverseH2);
+            __m128 total = _mm_setzero_ps(), inside = _mm_setzero_ps();
+#endif
+            ForEachNeighborRun(i, [&](uint32_t first, uint32_t last) {
+                uint32_t j = first;
+#ifdef PHYSICS_SSE
+                for (; j + 4 <= last; j += 4) {
+                    __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + j), cx), dy = _mm_sub_ps(_mm_loadu_ps(y + j), cy);
+                    __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + j), cz);
+                    __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                    __m128 s = _mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(r2, scaleQ)), _mm_setzero_ps());
+                    total = _mm_add_ps(total, _mm_mul_ps(_mm_mul_ps(s, s), s));
+                    inside = _mm_add_ps(inside, _mm_and_ps(_mm_cmpgt_ps(s, _mm_setzero_ps()), one));
+                }
+#endif
+                // Branchless: about one candidate in six is a neighbour, too unpredictable to branch on
+                for (; j < last; ++j) {
+                    Real dx = x[j] - xi, dy = y[j] - yi, dz = z[j] - zi;
+                    Real s = Max(Real(1) - (dx * dx + dy * dy + dz * dz) * inverseH2, Real(0));
+                    sum += s * s * s;
+                    count += s > Real(0);
+                }
+            });
+#ifdef PHYSICS_SSE
+            alignas(16) float lanes[2][4];
+            _mm_store_ps(lanes[0], total);
+            _mm_store_ps(lanes[1], inside);
+            sum += (lanes[0][0] + lanes[0][1]) + (lanes[0][2] + lanes[0][3]);
+            count += static_cast<uint32_t>((lanes[1][0] + lanes[1][1]) + (lanes[1][2] + lanes[1][3]));
+#endif
+            Real rho = sum * scale;
+            density[i] = rho;
+            pressureTerm[i] = Max(rho - config.restDensity, Real(0)) * config.stiffness / (rho * rho);
+            found += count;
+        }
+        neighbors += found;
+    });
+    stats.averageNeighbors = Real(static_cast<float>(neighbors.load()) / static_cast<float>(px.size()));
+}
+
+// Symmetric pressure force with the spiky gradient, and viscosity with its own laplacian kernel
+void FluidWorld::ComputeForces() {
+    const Real radius = config.smoothingRadius, inverseH = Real(1) / radius;
+    const Real radius2 = radius * radius, minDistance2 = radius2 * Real(1e-6f);
+    const Real pressureScale = particleMass * SPIKY * inverseH * inverseH * inverseH * inverseH;
+    const Real viscosityScale =
+        config.viscosity * particleMass * VISCOSITY_KERNEL * inverseH * inverseH * inverseH * inverseH * inverseH;
+    const Real *x = px.data(), *y = py.data(), *z = pz.data(), *u = vx.data(), *v = vy.data(), *w = vz.data();
+    const Real *term = pressureTerm.data(), *rho = density.data();
+    ParallelFor(static_cast<uint32_t>(px.size()), PARTICLE_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            const Real xi = x[i], yi = y[i], zi = z[i], ui = u[i], vi = v[i], wi = w[i], termI = term[i];
+            Real fx = Real(0), fy = Real(0), fz = Real(0);
+#ifdef PHYSICS_SSE
+            const __m128 cx = _mm_set1_ps(xi), cy = _mm_set1_ps(yi), cz = _mm_set1_ps(zi);
+            const __m128 cu = _mm_set1_ps(ui), cv = _mm_set1_ps(vi), cw = _mm_set1_ps(wi);
+            const __m128 one = _mm_set1_ps(1.0f), scaleR = _mm_set1_ps(inverseH), pressureI = _mm_set1_ps(termI);
+            const __m128 outer = _mm_set1_ps(radius2), inner = _mm_set1_ps(minDistance2);
+            __m128 sx = _mm_setzero_ps(), sy = _mm_setzero_ps(), sz = _mm_setzero_ps();
+#endif
+            ForEachNeighborRun(i, [&](uint32_t first, uint32_t last) {
+                uint32_t j = first;
+#ifdef PHYSICS_SSE
+                for (; j + 4 <= last; j += 4) {
+                    __m128 dx = _mm_sub_ps(cx, _mm_loadu_ps(x + j)), dy = _mm_sub_ps(cy, _mm_loadu_ps(y + j));
+                    __m128 dz = _mm_sub_ps(cz, _mm_loadu_ps(z + j));
+                    __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                    __m128 inside = _mm_and_ps(_mm_cmplt_ps(r2, outer), _mm_cmpgt_ps(r2, inner));
+                    __m128 r = _mm_sqrt_ps(r2);
+                    // Masked lanes may divide by zero; the mask clears whatever comes out
+                    __m128 s = _mm_and_ps(inside, _mm_sub_ps(one, _mm_mul_ps(r, scaleR)));
+                    __m128 push = _mm_div_ps(_mm_mul_ps(_mm_add_ps(pressureI, _mm_loadu_ps(term + j)),
+                                                        _mm_mul_ps(_mm_mul_ps(s, s), _mm_set1_ps(pressureScale))),
+                                             r);
+                    push = _mm_and_ps(inside, push);
+                    __m128 drag = _mm_div_ps(_mm_mul_ps(s, _mm_set1_ps(viscosityScale)), _mm_loadu_ps(rho + j));
+                    sx = _mm_add_ps(sx, _mm_add_ps(_mm_mul_ps(push, dx),
+                                                   _mm_mul_ps(drag, _mm_sub_ps(_mm_loadu_ps(u + j), cu))));
+                    sy = _mm_add_ps(sy, _mm_add_ps(_mm_mul_ps(push, dy),
+                                                   _mm_mul_ps(drag, _mm_sub_ps(_mm_loadu_ps(v + j), cv))));
+                    sz = _mm_add_ps(sz, _mm_add_ps(_mm_mul_ps(push, dz),
+                                                   _mm_mul_ps(drag, _mm_sub_ps(_mm_loadu_ps(w + j), cw))));
+                }
+#endif
+                for (; j < last; ++j) {
+                    Real dx = xi - x[j], dy = yi - y[j], dz = zi - z[j];
+                    Real r2 = dx * dx + dy * dy + dz * dz;
+                    if (r2 >= radius2 || r2 <= minDistance2) continue; // Out of range, or the particle itself
+                    Real r = Sqrt(r2);
+                    Real s = Real(1) - r * inverseH;
+                    // Pressure pushes i away from j: -grad W points from j to i
+                    Real push = (termI + term[j]) * s * s * pressureScale / r;
+                    Real drag = s * viscosityScale / rho[j];
+                    fx += push * dx + drag * (u[j] - ui);
+                    fy += push * dy + drag * (v[j] - vi);
+                    fz += push * dz + drag * (w[j] - wi);
+                }
+            });
+#ifdef PHYSICS_SSE
+            alignas(16) float lanes[3][4];
+            _mm_store_ps(lanes[0], sx);
+            _mm_store_ps(lanes[1], sy);
+            _mm_store_ps(lanes[2], sz);
+            fx += (lanes[0][0] + lanes[0][1]) + (lanes[0][2] + lanes[0][3]);
+            fy += (lanes[1][0] + lanes[1][1]) + (lanes[1][2] + lanes[1][3]);
+            fz += (lanes[2][0] + lanes[2][1]) + (lanes[2][2] + lanes[2][3]);
+#endif
+            ax[i] = fx + config.gravity.x;
+            ay[i] = fy + config.gravity.y;
+            az[i] = fz + config.gravity.z;
+        }
+    });
+}
+
+// Symplectic Euler, then back inside the container with the wall-normal velocity reflected
+void FluidWorld::Integrate(Real h) {
+    const Real bounce = -config.wallRestitution;
+    ParallelFor(static_cast<uint32_t>(px.size()), COLUMN_GRAIN, [&](uint32_t begin, uint32_t end) {
+        auto axis = [&](Real &p, Real &v, Real a, Real lo, Real hi) {
+            v += a * h;
+            p += v * h;
+            if (p < lo) {
+                p = lo;
+                v = v < Real(0) ? v * bounce : v;
+            } else if (p > hi) {
+                p = hi;
+                v = v > Real(0) ? v * bounce : v;
+            }
+        };
+        for (uint32_t i = begin; i < end; ++i) {
+            axis(px[i], vx[i], ax[i], container.min.x, container.max.x);
+            axis(py[i], vy[i], ay[i], container.min.y, container.max.y);
+            axis(pz[i], vz[i], az[i], container.min.z, container.max.z);
+        }
+    });
+}
+
+// ---- Scenes ----
+
+void SpawnDamBreak(FluidWorld &world, uint32_t count) {
+    // A column twice as tall as it is wide and deep, at the end of a tank four columns long
+    const Real spacing = world.GetConfig().smoothingRadius * Real(0.5f);
+    const int side = std::max(1, static_cast<int>(std::ceil(std::cbrt(count / 2.0))));
+    const Real width = spacing * Real(side);
+    world.SetContainer(Aabb{Vec3(width * Real(-2), Real(0), width * Real(-0.5f)),
+                            Vec3(width * Real(2), width * Real(3), width * Real(0.5f))});
+
+    const Aabb &tank = world.GetContainer();
+    uint32_t added = 0;
+    for (int y = 0; added < count; ++y) {
+        for (int z = 0; z < side && added < count; ++z) {
+            for (int x = 0; x < side && added < count; ++x) {
+                world.AddParticle(tank.min + Vec3(spacing * (Real(x) + Real(0.5f)), spacing * (Real(y) + Real(0.5f)),
+                                                  spacing * (Real(z) + Real(0.5f))));
+                added++;
+            }
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef FLUID_H
+#define FLUID_H
+
+#include "Memory.h"
+#include "PhysicsMath.h"
+
+#include <cstdint>
+
+class JobSystem;
+
+struct FluidConfig {
+    Vec3 gravity = Vec3(0, -9.81f, 0);
+    Real smoothingRadius = 0.08f; // Kernel support and grid cell size; particles spawn half this apart
+    Real restDensity = 1000.0f;
+    Real stiffness = 200.0f;      // Pressure per unit of density above rest, the squared speed of sound
+    Real viscosity = 0.01f;       // Kinematic, in square meters per second
+    Real wallRestitution = 0.2f;  // Bounce off the container walls
+    int substeps = 8;             // The step must stay below about 0.4 * smoothingRadius / speed of sound
+};
+
+// What the last Step did, summed over its substeps
+struct FluidStats {
+    uint32_t particles = 0;
+    uint32_t cells = 0;           // Grid cells in the container
+    Real averageNeighbors = 0.0f; // Within the smoothing radius, self included
+    double sortTime = 0.0, densityTime = 0.0, forceTime = 0.0, integrateTime = 0.0; // Seconds
+};
+
+// Weakly compressible smoothed-particle hydrodynamics (SPH) in a box container.
+//
+// Every substep bins the particles into a uniform grid with cells one smoothing radius wide, using
+// a counting sort by cell, and then reorders all particle columns into cell order. The particles of
+// a cell, and of a row of three neighbouring cells, are then contiguous. A neighbour search is
+// nine linear scans over memory that is already in cache. Density and force passes read
+// neighbours only and write their own particle, so they are split across jobs without locks.
+//
+// Particle indices therefore change every substep: the fluid is a field, not a set of tracked
+// particles.
+class FluidWorld {
+  public:
+    template <typename T> using Array = TaggedVector<T, MemTag::Physics>;
+
+    explicit FluidWorld(const FluidConfig &config = FluidConfig());
+
+    // Optional; without it everything runs on the calling thread
+    void SetJobSystem(JobSystem *jobs) { this->jobs = jobs; }
+
+    // Particles are kept inside this box, which also sizes the grid. Set before adding particles.
+    void SetContainer(const Aabb &box);
+    const Aabb &GetContainer() const { return container; }
+
+    void AddParticle(const Vec3 &position, const Vec3 &velocity = Vec3());
+    // Fill region with particles on a lattice half a smoothing radius apart, returns how many
+    uint32_t AddBlock(const Aabb &region, const Vec3 &velocity = Vec3());
+    void Clear();
+
+    void Step(Real dt);
+
+    size_t ParticleCount() const { return px.size(); }
+    Vec3 GetPosition(uint32_t particle) const { return Vec3(px[particle], py[particle], pz[particle]); }
+    Vec3 GetVelocity(uint32_t particle) const { return Vec3(vx[particle], vy[particle], vz[particle]); }
+    Real GetDensity(uint32_t particle) const { return density[particle]; }
+    Real GetParticleMass() const { return particleMass; }
+    const FluidStats &GetStats() const { return stats; }
+    const FluidConfig &GetConfig() const { return config; }
+
+  private:
+    template <typename F> void ParallelFor(uint32_t count, uint32_t grain, const F &fn) const;
+    void GridCoords(uint32_t particle, int32_t &x, int32_t &y, int32_t &z) const; // Clamped into the grid
+    // Call f(begin, end) for the nine runs of sorted particles around particle i's cell
+    template <typename F> void ForEachNeighborRun(uint32_t i, const F &f) const;
+
+    void SortByCell();
+    void ComputeDensity();
+    void ComputeForces();
+    void Integrate(Real h);
+
+    FluidConfig config;
+    JobSystem *jobs = nullptr;
+    Real particleMass;
+
+    // ---- Grid ----
+    Aabb container;
+    Real inverseCellSize;
+    int32_t gridX = 1, gridY = 1, gridZ = 1;
+    Array<uint32_t> cellStart; // First sorted particle of each cell, plus the end
+    Array<uint32_t> cell;      // Per particle
+    Array<uint32_t> order;     // Sorted slot of each particle
+
+    // ---- Particles, in cell order after every sort ----
+    Array<Real> px, py, pz;
+    Array<Real> vx, vy, vz;
+    Array<Real> ax, ay, az;
+    Array<Real> density;
+    Array<Real> pressureTerm; // Pressure over density squared
+    Array<Real> scratch;      // Reorder target, swapped with each column in turn
+
+    FluidStats stats;
+};
+
+// The fluid benchmark: a dam break, a column of count particles released at one end of a tank
+// four times as long as it is deep, centered on the grid
+void SpawnDamBreak(FluidWorld &world, uint32_t count);
+
+#endif
@@ -0,0 +1,167 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+// ---- TimeHistogram ----
+
+int TimeHistogram::BucketOf(uint64_t nanos) {
+    if (nanos < (1u << SUB_BITS)) return static_cast<int>(nanos);
+    int exponent = 63 - __builtin_clzll(nanos);
+    int sub = static_cast<int>((nanos >> (exponent - SUB_BITS)) & ((1u << SUB_BITS) - 1));
+    int bucket = ((exponent - SUB_BITS + 1) << SUB_BITS) + sub;
+    return bucket < BUCKET_COUNT ? bucket : BUCKET_COUNT - 1;
+}
+
+double TimeHistogram::BucketMidpoint(int bucket) {
+    if (bucket < (1 << SUB_BITS)) return bucket * 1e-9;
+    int exponent = (bucket >> SUB_BITS) + SUB_BITS - 1;
+    int sub = bucket & ((1 << SUB_BITS) - 1);
+    double width = std::ldexp(1.0, exponent - SUB_BITS);
+    double low = std::ldexp(1.0, exponent) + sub * width;
+    return (low + 0.5 * width) * 1e-9;
+}
+
+void TimeHistogram::Record(double seconds) {
+    uint64_t nanos = seconds > 0.0 ? static_cast<uint64_t>(std::llround(seconds * 1e9)) : 0;
+    buckets[BucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t seen = maxNanos.load(std::memory_order_relaxed);
+    while (nanos > seen && !maxNanos.compare_exchange_weak(seen, nanos, std::memory_order_relaxed)) {
+    }
+}
+
+void TimeHistogram::Reset() {
+    for (std::atomic<uint64_t> &bucket : buckets) bucket.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    maxNanos.store(0, std::memory_order_relaxed);
+}
+
+TimeHistogram::Summary TimeHistogram::Summarize() const {
+    // Copy once so concurrent records can't make the walk inconsistent
+    uint64_t copy[BUCKET_COUNT];
+    uint64_t n = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        copy[i] = buckets[i].load(std::memory_order_relaxed);
+        n += copy[i];
+    }
+
+    Summary summary = {n, 0.0, 0.0, 0.0, maxNanos.load(std::memory_order_relaxed) * 1e-9};
+    if (n == 0) return summary;
+
+    const double quantiles[3] = {0.50, 0.95, 0.99};
+    double *outputs[3] = {&summary.p50, &summary.p95, &summary.p99};
+    uint64_t seen = 0;
+    int q = 0;
+    for (int i = 0; i < BUCKET_COUNT && q < 3; ++i) {
+        seen += copy[i];
+        while (q < 3 && seen >= static_cast<uint64_t>(std::ceil(quantiles[q] * n))) {
+            *outputs[q] = std::min(BucketMidpoint(i), summary.max);
+            ++q;
+        }
+    }
+    return summary;
+}
+
+// ---- FrameStats ----
+
+static const char *CHANNEL_NAMES[FrameStats::CHANNEL_COUNT] = {"frame", "update", "render", "swap", "gpu"};
+
+bool FrameStats::Open(const std::string &csvPath, double reportInterval, double now) {
+    interval = reportInterval;
+    openTime = windowStart = now;
+    frameIndex = 0;
+
+    if (csvPath.empty()) return true;
+    csv = fopen(csvPath.c_str(), "w");
+    if (!csv) return false;
+    // Rows go out in large blocks, not one write per frame
+    setvbuf(csv, nullptr, _IOFBF, 1 << 20);
+    fprintf(csv, "frame,frame_ms,ticks,update_ms,render_ms,swap_ms,allocs,gpu_ms,scale\n");
+    return true;
+}
+
+void FrameStats::Close() {
+    if (!csv) return;
+    fclose(csv);
+    csv = nullptr;
+}
+
+void FrameStats::RecordUpdate(double seconds) {
+    window[UPDATE].Record(seconds);
+    total[UPDATE].Record(seconds);
+    pendingUpdateNanos.fetch_add(static_cast<uint64_t>(std::llround(seconds * 1e9)), std::memory_order_relaxed);
+    pendingTicks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameStats::RecordGpu(double seconds) {
+    window[GPU].Record(seconds);
+    total[GPU].Record(seconds);
+    lastGpu = seconds;
+}
+
+void FrameStats::RecordRenderScale(float scale) {
+    frameScale = scale;
+    for (FrameCounts *counts : {&windowCounts, &totalCounts}) {
+        counts->scaledFrames++;
+        counts->scaleSum += scale;
+        counts->minScale = std::min(counts->minScale, scale);
+    }
+}
+
+void FrameStats::EndFrame(double frame, double render, double swap, uint64_t allocations, double now) {
+    const double values[3] = {frame, render, swap};
+    const Channel channels[3] = {FRAME, RENDER, SWAP};
+    for (int i = 0; i < 3; ++i) {
+        window[channels[i]].Record(values[i]);
+        total[channels[i]].Record(values[i]);
+    }
+    for (FrameCounts *counts : {&windowCounts, &totalCounts}) {
+        counts->allocations += allocations;
+        counts->allocatingFrames += allocations > 0;
+        counts->maxAllocations = std::max(counts->maxAllocations, allocations);
+    }
+
+    uint64_t updateNanos = pendingUpdateNanos.exchange(0, std::memory_order_relaxed);
+    uint32_t ticks = pendingTicks.exchange(0, std::memory_order_relaxed);
+    if (csv) {
+        fprintf(csv, "%llu,%.4f,%u,%.4f,%.4f,%.4f,%llu,%.4f,%.2f\n", static_cast<unsigned long long>(frameIndex),
+                frame * 1e3, ticks, updateNanos * 1e-6, render * 1e3, swap * 1e3,
+                static_cast<unsigned long long>(allocations), lastGpu * 1e3, frameScale);
+    }
+    frameIndex++;
+
+    if (interval > 0.0 && now - windowStart >= interval) {
+        Report("last", window, windowCounts, now - windowStart);
+        for (TimeHistogram &histogram : window) histogram.Reset();
+        windowCounts = FrameCounts();
+        windowStart = now;
+    }
+}
+
+void FrameStats::ReportTotal(double now) const {
+    if (total[FRAME].Summarize().count == 0) return;
+    Report("total", total, totalCounts, now - openTime);
+}
+
+void FrameStats::Report(const char *title, const TimeHistogram *channels, const FrameCounts &counts,
+                        double seconds) const {
+    const TimeHistogram::Summary frames = channels[FRAME].Summarize();
+    printf("[stats] %s %.1f s: %llu frames (%.1f fps)\n", title, seconds,
+           static_cast<unsigned long long>(frames.count), seconds > 0.0 ? frames.count / seconds : 0.0);
+    printf("          %9s %9s %9s %9s %9s\n", "count", "p50 ms", "p95 ms", "p99 ms", "max ms");
+
+    for (int c = 0; c < CHANNEL_COUNT; ++c) {
+        const TimeHistogram::Summary s = channels[c].Summarize();
+        if (c == GPU && s.count == 0) continue; // Only measured with dynamic resolution
+        printf("  %-7s %9llu %9.3f %9.3f %9.3f %9.3f\n", CHANNEL_NAMES[c], static_cast<unsigned long long>(s.count),
+               s.p50 * 1e3, s.p95 * 1e3, s.p99 * 1e3, s.max * 1e3);
+    }
+    if (counts.scaledFrames > 0)
+        printf("  render scale: mean %.2f, min %.2f\n", counts.scaleSum / counts.scaledFrames, counts.minScale);
+    printf("  heap allocations: %llu in %llu of %llu frames (max %llu in one frame)\n",
+           static_cast<unsigned long long>(counts.allocations), static_cast<unsigned long long>(counts.allocatingFrames),
+           static_cast<unsigned long long>(frames.count), static_cast<unsigned long long>(counts.maxAllocations));
+    fflush(stdout);
+}
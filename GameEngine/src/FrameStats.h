@@ -0,0 +1,87 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Lock-free log-linear histogram of durations. Any number of threads may Record() concurrently;
+// percentiles come out within one bucket (about 6%) of the true value.
+class TimeHistogram {
+  public:
+    TimeHistogram() { Reset(); }
+
+    void Record(double seconds);
+    void Reset();
+
+    struct Summary {
+        uint64_t count;
+        double p50, p95, p99, max; // Seconds
+    };
+    Summary Summarize() const;
+
+  private:
+    // 16 buckets per power of two of nanoseconds, up to 2^36 ns (about 69 s)
+    static const int SUB_BITS = 4;
+    static const int BUCKET_COUNT = 34 << SUB_BITS;
+
+    static int BucketOf(uint64_t nanos);
+    static double BucketMidpoint(int bucket);
+
+    std::atomic<uint64_t> buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> maxNanos;
+};
+
+// Per-frame timing for Engine::Run: CPU frame, update, render and swap times, plus GPU scene time
+// and render scale when dynamic resolution is on.
+// Update is recorded from the simulation thread, everything else from the main thread.
+class FrameStats {
+  public:
+    enum Channel { FRAME, UPDATE, RENDER, SWAP, GPU, CHANNEL_COUNT };
+
+    ~FrameStats() { Close(); }
+
+    // csvPath empty = no per-frame CSV
+    bool Open(const std::string &csvPath, double reportInterval, double now);
+    void Close();
+
+    void RecordUpdate(double seconds);   // One tick, any thread
+    void RecordGpu(double seconds);      // Scene pass GPU time, whenever a timer query completes
+    void RecordRenderScale(float scale); // Dynamic resolution scale of the current frame
+    // Main thread, once a frame. allocations = heap allocations made by any thread during the frame.
+    void EndFrame(double frame, double render, double swap, uint64_t allocations, double now);
+
+    // Print percentiles for the whole run
+    void ReportTotal(double now) const;
+
+  private:
+    // Heap allocation counts and render scale next to the timings
+    struct FrameCounts {
+        uint64_t allocations = 0;
+        uint64_t allocatingFrames = 0; // Frames that allocated at all
+        uint64_t maxAllocations = 0;   // Most in one frame
+        uint64_t scaledFrames = 0;
+        double scaleSum = 0.0;
+        float minScale = 1.0f;
+    };
+
+    void Report(const char *title, const TimeHistogram *channels, const FrameCounts &counts, double seconds) const;
+
+    TimeHistogram window[CHANNEL_COUNT]; // Since the last periodic report
+    TimeHistogram total[CHANNEL_COUNT];  // Since Open()
+    FrameCounts windowCounts, totalCounts;
+
+    FILE *csv = nullptr;
+    uint64_t frameIndex = 0;
+    std::atomic<uint64_t> pendingUpdateNanos{0}; // Update time since the last EndFrame, for the CSV
+    std::atomic<uint32_t> pendingTicks{0};
+    double lastGpu = 0.0;    // Newest GPU time, for the CSV
+    float frameScale = 1.0f; // Scale recorded for the current frame
+
+    double interval = 0.0;
+    double openTime = 0.0, windowStart = 0.0;
+};
+
+#endif
@@ -0,0 +1,281 @@
+#include "JobSystem.h"
+#include "Memory.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#include <immintrin.h>
+#define CPU_PAUSE() _mm_pause()
+#else
+#define CPU_PAUSE() std::this_thread::yield()
+#endif
+
+// Which JobSystem and deque the current thread owns (-1 = none, submissions go to the injection queue)
+static thread_local JobSystem *tlsSystem = nullptr;
+static thread_local int tlsQueue = -1;
+
+// ---- WorkDeque ----
+
+bool WorkDeque::Push(QueuedJob *job) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t >= CAPACITY) return false;
+    slots[b & (CAPACITY - 1)].store(job, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+QueuedJob *WorkDeque::Pop() {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        // Empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    QueuedJob *job = slots[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        // Last item: race thieves for it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+QueuedJob *WorkDeque::Steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+
+    QueuedJob *job = slots[t & (CAPACITY - 1)].load(std::memory_order_acquire);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+    return job;
+}
+
+// ---- JobSystem ----
+
+JobSystem::JobSystem() {}
+
+JobSystem::~JobSystem() { Stop(); }
+
+bool JobSystem::Start(int workerCount) {
+    if (running) return true;
+    MemScope scope(MemTag::Jobs);
+    if (workerCount < 0) {
+        int hardware = static_cast<int>(std::thread::hardware_concurrency());
+        workerCount = hardware > 1 ? hardware - 1 : 0;
+    }
+
+    queues.clear();
+    for (int i = 0; i < 1 + workerCount + MAX_EXTRA_THREADS; ++i) queues.emplace_back(new ThreadQueue());
+
+    // The starting thread is the main thread and owns queue 0
+    tlsSystem = this;
+    tlsQueue = 0;
+    registeredThreads = 0;
+
+    running = true;
+    for (int i = 1; i <= workerCount; ++i) workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+    return true;
+}
+
+void JobSystem::Stop() {
+    if (!running.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> lock(sleepLock);
+        wake.notify_all();
+    }
+    for (std::thread &worker : workers) worker.join();
+    workers.clear();
+    if (tlsSystem == this) {
+        tlsSystem = nullptr;
+        tlsQueue = -1;
+    }
+}
+
+void JobSystem::RegisterThread() {
+    int slot = registeredThreads.fetch_add(1);
+    if (slot >= MAX_EXTRA_THREADS) return; // Out of deques, this thread keeps using the injection queue
+    tlsSystem = this;
+    tlsQueue = 1 + WorkerCount() + slot;
+}
+
+void JobSystem::Run(const Job *jobs, int count, JobCounter *counter, JobCounter *dependency) {
+    if (count <= 0) return;
+    if (counter) counter->value.fetch_add(count, std::memory_order_relaxed);
+
+    if (dependency) {
+        // Checked under the lock so a concurrent Finish() either sees our continuations or we see zero
+        std::lock_guard<std::mutex> lock(dependency->lock);
+        if (dependency->value.load(std::memory_order_acquire) > 0) {
+            for (int i = 0; i < count; ++i) dependency->continuations.push_back({jobs[i], counter});
+            return;
+        }
+    }
+
+    for (int i = 0; i < count; ++i) Submit(jobs[i], counter);
+}
+
+void JobSystem::Submit(const Job &job, JobCounter *counter) {
+    if (tlsSystem == this && tlsQueue >= 0) {
+        ThreadQueue &queue = *queues[tlsQueue];
+        QueuedJob *slot = &queue.ring[queue.ringNext++ & (RING_SIZE - 1)];
+        slot->job = job;
+        slot->counter = counter;
+        if (!queue.deque.Push(slot)) {
+            // Deque full: doing the work now beats blocking
+            Execute(*slot);
+            return;
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(injectLock);
+        injected.push_back({job, counter});
+        injectedCount.fetch_add(1, std::memory_order_release);
+    }
+    WakeWorkers();
+}
+
+void JobSystem::WakeWorkers() {
+    workEpoch.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(sleepLock);
+        wake.notify_one();
+    }
+}
+
+void JobSystem::Execute(const QueuedJob &queued) {
+    // Copy out first: the ring slot may be reused as soon as the job is done
+    QueuedJob local = queued;
+    local.job.function(local.job);
+    Finish(local.counter);
+}
+
+void JobSystem::Finish(JobCounter *counter) {
+    if (!counter) return;
+
+    // Hold the counter open while we may still touch it: a waiter can destroy it the moment it reads Done()
+    counter->finishing.fetch_add(1, std::memory_order_seq_cst);
+    if (counter->value.fetch_sub(1, std::memory_order_seq_cst) == 1) {
+        // Last job of the counter: release everything that was waiting on it
+        std::vector<JobCounter::Continuation> released;
+        {
+            std::lock_guard<std::mutex> lock(counter->lock);
+            released.swap(counter->continuations);
+        }
+        for (const JobCounter::Continuation &c : released) Submit(c.job, c.counter);
+    }
+    counter->finishing.fetch_sub(1, std::memory_order_release);
+}
+
+bool JobSystem::TryRunOne(int self) {
+    if (self >= 0) {
+        if (QueuedJob *job = queues[self]->deque.Pop()) {
+            Execute(*job);
+            return true;
+        }
+    }
+
+    if (self == 0 && mainJobCount.load(std::memory_order_acquire) > 0) {
+        QueuedJob job;
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lock(mainLock);
+            if (!mainJobs.empty()) {
+                job = mainJobs.back();
+                mainJobs.pop_back();
+                mainJobCount.fetch_sub(1, std::memory_order_relaxed);
+                found = true;
+            }
+        }
+        if (found) {
+            Execute(job);
+            return true;
+        }
+    }
+
+    if (injectedCount.load(std::memory_order_acquire) > 0) {
+        QueuedJob job;
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lock(injectLock);
+            if (!injected.empty()) {
+                job = injected.front();
+                injected.pop_front();
+                injectedCount.fetch_sub(1, std::memory_order_relaxed);
+                found = true;
+            }
+        }
+        if (found) {
+            Execute(job);
+            return true;
+        }
+    }
+
+    // Steal, starting from a different victim per thread to spread contention
+    const int count = static_cast<int>(queues.size());
+    const int start = self >= 0 ? self + 1 : 0;
+    for (int i = 0; i < count; ++i) {
+        int victim = (start + i) % count;
+        if (victim == self) continue;
+        if (QueuedJob *job = queues[victim]->deque.Steal()) {
+            Execute(*job);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::Wait(JobCounter &counter) {
+    const int self = tlsSystem == this ? tlsQueue : -1;
+    while (!counter.Done()) {
+        if (!TryRunOne(self)) CPU_PAUSE();
+    }
+}
+
+void JobSystem::RunOnMainThread(const Job &job, JobCounter *counter) {
+    if (counter) counter->value.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mainLock);
+    mainJobs.push_back({job, counter});
+    mainJobCount.fetch_add(1, std::memory_order_release);
+}
+
+void JobSystem::PumpMainThread() {
+    if (mainJobCount.load(std::memory_order_acquire) == 0) return;
+    std::vector<QueuedJob> pending;
+    {
+        std::lock_guard<std::mutex> lock(mainLock);
+        pending.swap(mainJobs);
+        mainJobCount.store(0, std::memory_order_relaxed);
+    }
+    for (const QueuedJob &job : pending) Execute(job);
+}
+
+void JobSystem::WorkerLoop(int index) {
+    tlsSystem = this;
+    tlsQueue = index;
+
+    const int spinsBeforeSleep = 64;
+    while (running.load(std::memory_order_acquire)) {
+        uint64_t epoch = workEpoch.load(std::memory_order_seq_cst);
+
+        bool ran = false;
+        for (int spin = 0; spin < spinsBeforeSleep && !ran; ++spin) {
+            ran = TryRunOne(index);
+            if (!ran) CPU_PAUSE();
+        }
+        if (ran) continue;
+
+        // Nothing anywhere: sleep until someone submits
+        std::unique_lock<std::mutex> lock(sleepLock);
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        wake.wait(lock, [&] {
+            return !running.load(std::memory_order_acquire) || workEpoch.load(std::memory_order_seq_cst) != epoch;
+        });
+        sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    }
+}
@@ -0,0 +1,155 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A unit of work. Plain data: a function, its argument and an optional index range.
+struct Job {
+    void (*function)(const Job &job) = nullptr;
+    void *data = nullptr;
+    uint32_t begin = 0, end = 0; // Range handed to parallel-for chunks, free for other jobs to use
+};
+
+// Counts unfinished jobs. Wait on it, or make other jobs depend on it reaching zero.
+class JobCounter {
+  public:
+    bool Done() const {
+        return value.load(std::memory_order_seq_cst) == 0 && finishing.load(std::memory_order_acquire) == 0;
+    }
+
+  private:
+    friend class JobSystem;
+
+    struct Continuation {
+        Job job;
+        JobCounter *counter;
+    };
+
+    std::atomic<int> value{0};
+    std::atomic<int> finishing{0};           // Threads inside Finish(), the counter must outlive them
+    std::mutex lock;                         // Guards continuations
+    std::vector<Continuation> continuations; // Released when value drops to zero
+};
+
+// A job waiting in a queue, with the counter to lower when it finishes
+struct QueuedJob {
+    Job job;
+    JobCounter *counter = nullptr;
+};
+
+// Fixed-capacity Chase-Lev work-stealing deque. The owning thread pushes and pops at the bottom,
+// any other thread steals from the top. Stores pointers so a steal is a single atomic load.
+class WorkDeque {
+  public:
+    static const int64_t CAPACITY = 1024;
+
+    bool Push(QueuedJob *job); // Owner only, false when full
+    QueuedJob *Pop();          // Owner only
+    QueuedJob *Steal();        // Any thread
+
+  private:
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    alignas(64) std::atomic<QueuedJob *> slots[CAPACITY] = {};
+};
+
+// Engine-wide scheduler: one worker thread per spare core, each with its own deque.
+// The main thread and any registered thread (the simulation thread) also own a deque and
+// execute jobs while they Wait. Jobs that must touch GL go through RunOnMainThread.
+class JobSystem {
+  public:
+    JobSystem();
+    ~JobSystem();
+
+    bool Start(int workerCount = -1); // -1 = one worker per hardware thread, minus the main thread
+    void Stop();
+    int WorkerCount() const { return static_cast<int>(workers.size()); }
+
+    // Give the calling thread its own deque so its submissions and waits are lock-free.
+    // The main thread is registered by Start(); at most MAX_EXTRA_THREADS others may register.
+    void RegisterThread();
+
+    // Queue jobs. counter (may be null) is raised by count now and lowered as each job finishes.
+    // With a dependency, the jobs are held back until that counter reaches zero.
+    void Run(const Job *jobs, int count, JobCounter *counter, JobCounter *dependency = nullptr);
+    void Run(const Job &job, JobCounter *counter, JobCounter *dependency = nullptr) {
+        Run(&job, 1, counter, dependency);
+    }
+
+    // Block until counter is zero, running other jobs in the meantime
+    void Wait(JobCounter &counter);
+
+    // Call fn(begin, end) over [0, count) in chunks of grainSize spread across all workers,
+    // returning once every chunk is done. The caller runs a chunk itself.
+    template <typename F> void ParallelFor(uint32_t count, uint32_t grainSize, const F &fn) {
+        if (count == 0) return;
+        if (grainSize == 0) grainSize = 1;
+        if (count <= grainSize || workers.empty()) {
+            fn(0u, count);
+            return;
+        }
+
+        JobCounter counter;
+        Job job;
+        job.function = [](const Job &j) { (*static_cast<const F *>(j.data))(j.begin, j.end); };
+        job.data = const_cast<F *>(&fn);
+        for (uint32_t begin = grainSize; begin < count; begin += grainSize) {
+            job.begin = begin;
+            job.end = begin + grainSize < count ? begin + grainSize : count;
+            Run(job, &counter);
+        }
+        fn(0u, grainSize);
+        Wait(counter);
+    }
+
+    // Jobs that may only run on the main thread (GL calls). Safe to queue from any thread;
+    // they run in PumpMainThread() or while the main thread is inside Wait().
+    void RunOnMainThread(const Job &job, JobCounter *counter);
+    void PumpMainThread();
+
+  private:
+    static const int MAX_EXTRA_THREADS = 4;
+    static const int RING_SIZE = 4096; // Per-thread job records, must exceed WorkDeque::CAPACITY
+
+    struct ThreadQueue {
+        WorkDeque deque;
+        std::unique_ptr<QueuedJob[]> ring{new QueuedJob[RING_SIZE]};
+        uint32_t ringNext = 0;
+    };
+
+    void WorkerLoop(int index);
+    void Submit(const Job &job, JobCounter *counter);
+    bool TryRunOne(int self);
+    void Execute(const QueuedJob &queued);
+    void Finish(JobCounter *counter);
+    void WakeWorkers();
+
+    std::vector<std::unique_ptr<ThreadQueue>> queues; // [0] main, [1..workers] workers, then registered threads
+    std::vector<std::thread> workers;
+    std::atomic<int> registeredThreads{0};
+    std::atomic<bool> running{false};
+
+    // Submissions from threads without a deque
+    std::mutex injectLock;
+    std::deque<QueuedJob> injected;
+    std::atomic<int> injectedCount{0};
+
+    std::mutex mainLock;
+    std::vector<QueuedJob> mainJobs;
+    std::atomic<int> mainJobCount{0};
+
+    // Idle workers sleep here until the work epoch changes
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    std::atomic<uint64_t> workEpoch{0};
+    std::atomic<int> sleepers{0};
+};
+
+#endif
@@ -0,0 +1,235 @@
+#include "Log.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+// Bounded MPSC ring (Vyukov). A slot's sequence holds the start of the lap it belongs to: for
+// position p in lap L = p & ~(CAPACITY - 1) the slot is free for a producer when its sequence is
+// L, readable by the consumer at L + 1, and handed to the next lap as L + CAPACITY. Starting
+// from all zeroes means the ring needs no initialisation.
+static const uint64_t CAPACITY = 4096; // Power of two, about 1 MB of records
+static const uint64_t LAP_MASK = ~(CAPACITY - 1);
+static LogRecord ring[CAPACITY];
+alignas(64) static std::atomic<uint64_t> head{0}; // Next position producers claim
+alignas(64) static std::atomic<uint64_t> tail{0}; // Next position the consumer reads
+static std::atomic<uint64_t> dropped{0};
+
+static std::thread writer;
+static std::atomic<bool> running{false};
+static std::mutex wakeLock;
+static std::condition_variable wake;
+static FILE *output = nullptr; // Null = stderr
+static std::mutex drainLock;   // One consumer at a time: the writer thread, or callers while it is not running
+
+std::atomic<LogLevel> Log::minLevel{LogLevel::Info};
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+int64_t Log::Timestamp() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+LogRecord *Log::Claim(uint64_t &position) {
+    uint64_t pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+        LogRecord &slot = ring[pos & (CAPACITY - 1)];
+        int64_t diff = static_cast<int64_t>(slot.sequence.load(std::memory_order_acquire) - (pos & LAP_MASK));
+        if (diff == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                position = pos;
+                return &slot;
+            }
+        } else if (diff < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed); // Full, the writer is a lap behind
+            return nullptr;
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Expand {} placeholders from the encoded arguments
+static void Format(const LogRecord &record, std::string &out) {
+    static const char LEVELS[] = {'D', 'I', 'W', 'E'};
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "[%10.3f] %c ", record.time / 1e9, LEVELS[static_cast<int>(record.level)]);
+    out += prefix;
+
+    const unsigned char *arg = record.payload;
+    const unsigned char *end = record.payload + record.size;
+    for (const char *f = record.format; *f; ++f) {
+        if (f[0] != '{' || f[1] != '}' || arg >= end) {
+            out += *f;
+            continue;
+        }
+        ++f;
+
+        char text[32];
+        uint8_t tag = *arg++;
+        switch (tag) {
+        case LogEncoder::INT: {
+            int64_t v;
+            memcpy(&v, arg, sizeof(v));
+            arg += sizeof(v);
+            snprintf(text, sizeof(text), "%lld", static_cast<long long>(v));
+            out += text;
+            break;
+        }
+        case LogEncoder::UINT: {
+            uint64_t v;
+            memcpy(&v, arg, sizeof(v));
+            arg += sizeof(v);
+            snprintf(text, sizeof(text), "%llu", static_cast<unsigned long long>(v));
+            out += text;
+            break;
+        }
+        case LogEncoder::FLOAT: {
+            double v;
+            memcpy(&v, arg, sizeof(v));
+            arg += sizeof(v);
+            snprintf(text, sizeof(text), "%g", v);
+            out += text;
+            break;
+        }
+        case LogEncoder::BOOL:
+            out += *arg++ ? "true" : "false";
+            break;
+        case LogEncoder::CHAR:
+            out += static_cast<char>(*arg++);
+            break;
+        case LogEncoder::STRING: {
+            size_t length = *arg++;
+            out.append(reinterpret_cast<const char *>(arg), length);
+            arg += length;
+            break;
+        }
+        case LogEncoder::POINTER: {
+            const void *p;
+            memcpy(&p, arg, sizeof(p));
+            arg += sizeof(p);
+            snprintf(text, sizeof(text), "%p", p);
+            out += text;
+            break;
+        }
+        }
+    }
+    out += '\n';
+}
+
+// Format and write everything readable, in order. Returns false when there was nothing.
+static bool Drain(std::string &batch) {
+    std::lock_guard<std::mutex> lock(drainLock);
+    uint64_t pos = tail.load(std::memory_order_relaxed);
+    batch.clear();
+    for (;;) {
+        LogRecord &slot = ring[pos & (CAPACITY - 1)];
+        uint64_t lap = pos & LAP_MASK;
+        if (slot.sequence.load(std::memory_order_acquire) != lap + 1) break; // Empty, or still being filled
+        Format(slot, batch);
+        slot.sequence.store(lap + CAPACITY, std::memory_order_release);
+        ++pos;
+        if (batch.size() > 64 * 1024) break; // Write in bounded chunks
+    }
+    tail.store(pos, std::memory_order_release);
+
+    uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+    if (lost > 0) {
+        char line[64];
+        snprintf(line, sizeof(line), "[log] %llu messages dropped, ring full\n", static_cast<unsigned long long>(lost));
+        batch += line;
+    }
+    if (batch.empty()) return false;
+
+    FILE *file = output ? output : stderr;
+    fwrite(batch.data(), 1, batch.size(), file);
+    fflush(file);
+    return true;
+}
+
+void Log::Commit(LogRecord *record, uint64_t position) {
+    bool urgent = record->level == LogLevel::Error; // The slot is not ours to read once published
+    record->sequence.store((position & LAP_MASK) + 1, std::memory_order_release);
+
+    if (!running.load(std::memory_order_acquire)) {
+        // No writer thread: write synchronously. A record stuck behind one that another thread is
+        // still filling gets written by that thread's drain.
+        std::string batch;
+        Drain(batch);
+        return;
+    }
+    // Errors usually come right before things go wrong, so do not let them sit in the ring.
+    // Also nudge the writer every half ring so bursts do not overflow while it polls.
+    if (urgent || (position & (CAPACITY / 2 - 1)) == 0) wake.notify_one();
+}
+
+static void WriterLoop() {
+    std::string batch;
+    batch.reserve(64 * 1024);
+    while (running.load(std::memory_order_acquire)) {
+        if (Drain(batch)) continue;
+        // Producers never signal for ordinary messages, so poll at a relaxed pace
+        std::unique_lock<std::mutex> lock(wakeLock);
+        wake.wait_for(lock, std::chrono::milliseconds(10));
+    }
+    while (Drain(batch)) {
+    }
+}
+
+bool Log::Start(const std::string &path) {
+    if (running.load()) return true;
+
+    bool opened = true;
+    if (!path.empty()) {
+        FILE *file = fopen(path.c_str(), "w");
+        std::lock_guard<std::mutex> lock(drainLock);
+        if (file) {
+            output = file;
+        } else {
+            opened = false;
+        }
+    }
+
+    running.store(true, std::memory_order_release);
+    writer = std::thread(WriterLoop);
+    if (!opened) LOG_ERROR("Cannot open log file {}, logging to stderr", path);
+    return opened;
+}
+
+void Log::Stop() {
+    if (!running.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> lock(wakeLock);
+        wake.notify_one();
+    }
+    writer.join();
+
+    // Producers racing with Stop may have committed after the final drain
+    std::string batch;
+    while (Drain(batch)) {
+    }
+    std::lock_guard<std::mutex> lock(drainLock);
+    if (output) fclose(output);
+    output = nullptr;
+}
+
+void Log::Flush() {
+    uint64_t target = head.load(std::memory_order_acquire);
+    while (running.load(std::memory_order_acquire) && tail.load(std::memory_order_acquire) < target) {
+        wake.notify_one();
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+bool Log::ParseLevel(const char *name, LogLevel &level) {
+    static const char *NAMES[] = {"debug", "info", "warn", "error"};
+    for (int i = 0; i < 4; ++i) {
+        if (strcmp(name, NAMES[i]) == 0) {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,125 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+enum class LogLevel : uint8_t { Debug, Info, Warn, Error };
+
+// One queued message: the format string pointer and its arguments in binary form.
+// Formatting happens later on the logger thread, so the format must be a string literal.
+struct LogRecord {
+    static const size_t PAYLOAD = 200;
+
+    std::atomic<uint64_t> sequence{0}; // Ring slot state, see Log.cpp
+    int64_t time = 0;                  // steady_clock nanoseconds
+    const char *format = nullptr;
+    LogLevel level = LogLevel::Info;
+    uint16_t size = 0; // Payload bytes in use
+    unsigned char payload[PAYLOAD];
+};
+
+// Argument encoding: a type tag byte followed by the raw value. Strings are copied
+// (length byte + bytes, truncated) since the caller's buffer may be gone by the time we format.
+class LogEncoder {
+  public:
+    enum Tag : uint8_t { INT, UINT, FLOAT, BOOL, CHAR, STRING, POINTER };
+
+    explicit LogEncoder(LogRecord &record) : record(record) {}
+
+    template <typename T> void Put(const T &value) {
+        if constexpr (std::is_same<T, bool>::value) {
+            Raw(BOOL, &value, 1);
+        } else if constexpr (std::is_same<T, char>::value) {
+            Raw(CHAR, &value, 1);
+        } else if constexpr (std::is_enum<T>::value) {
+            Put(static_cast<typename std::underlying_type<T>::type>(value));
+        } else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value) {
+            int64_t v = value;
+            Raw(INT, &v, sizeof(v));
+        } else if constexpr (std::is_integral<T>::value) {
+            uint64_t v = value;
+            Raw(UINT, &v, sizeof(v));
+        } else if constexpr (std::is_floating_point<T>::value) {
+            double v = value;
+            Raw(FLOAT, &v, sizeof(v));
+        } else if constexpr (std::is_same<T, std::string>::value) {
+            String(value.data(), value.size());
+        } else if constexpr (std::is_convertible<T, const char *>::value) {
+            const char *s = value;
+            String(s ? s : "(null)", s ? strlen(s) : 6);
+        } else {
+            static_assert(std::is_pointer<T>::value, "unsupported log argument type");
+            const void *p = value;
+            Raw(POINTER, &p, sizeof(p));
+        }
+    }
+
+  private:
+    void Raw(Tag tag, const void *value, size_t bytes) {
+        if (record.size + 1 + bytes > LogRecord::PAYLOAD) return; // Out of room, argument prints as {}
+        record.payload[record.size++] = tag;
+        memcpy(record.payload + record.size, value, bytes);
+        record.size += static_cast<uint16_t>(bytes);
+    }
+
+    void String(const char *s, size_t length) {
+        size_t room = LogRecord::PAYLOAD - record.size;
+        if (room < 2) return;
+        if (length > room - 2) length = room - 2;
+        if (length > 255) length = 255;
+        record.payload[record.size++] = STRING;
+        record.payload[record.size++] = static_cast<unsigned char>(length);
+        memcpy(record.payload + record.size, s, length);
+        record.size += static_cast<uint16_t>(length);
+    }
+
+    LogRecord &record;
+};
+
+// Asynchronous logger. Any thread claims a slot in a fixed MPSC ring with one CAS, copies its
+// arguments in and returns; a background thread formats and writes batches to stderr or a file.
+// When the ring is full the message is dropped and counted rather than blocking the caller.
+// Before Start() (and after Stop()) messages are formatted and written synchronously.
+class Log {
+  public:
+    static bool Start(const std::string &path = ""); // "" = stderr
+    static void Stop();                               // Drain everything queued and join the thread
+    static void Flush();                              // Block until everything queued so far is written
+
+    static void SetLevel(LogLevel level) { minLevel.store(level, std::memory_order_relaxed); }
+    static bool Enabled(LogLevel level) { return level >= minLevel.load(std::memory_order_relaxed); }
+    static bool ParseLevel(const char *name, LogLevel &level);
+
+    // {} in format is replaced by the next argument
+    template <typename... Args> static void Write(LogLevel level, const char *format, const Args &...args) {
+        if (!Enabled(level)) return;
+        uint64_t position;
+        LogRecord *record = Claim(position);
+        if (!record) return;
+        record->time = Timestamp();
+        record->format = format;
+        record->level = level;
+        record->size = 0;
+        LogEncoder encoder(*record);
+        (encoder.Put(args), ...);
+        Commit(record, position);
+    }
+
+  private:
+    static LogRecord *Claim(uint64_t &position); // Null when the ring is full
+    static void Commit(LogRecord *record, uint64_t position);
+    static int64_t Timestamp();
+
+    static std::atomic<LogLevel> minLevel;
+};
+
+#define LOG_DEBUG(...) Log::Write(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) Log::Write(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...) Log::Write(LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) Log::Write(LogLevel::Error, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,209 @@
+#include "Memory.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// Constant-initialized so operator new can count before any constructor has run
+static MemCounters counters[static_cast<int>(MemTag::COUNT)];
+static std::atomic<uint64_t> totalAllocations{0};
+static thread_local MemTag currentTag = MemTag::General;
+
+static const char *TAG_NAMES[] = {"general", "render", "physics", "jobs", "frame", "entities"};
+
+MemCounters &MemStats(MemTag tag) { return counters[static_cast<int>(tag)]; }
+
+const char *MemTagName(MemTag tag) { return TAG_NAMES[static_cast<int>(tag)]; }
+
+uint64_t MemTotalAllocations() { return totalAllocations.load(std::memory_order_relaxed); }
+
+void MemRecordAlloc(MemTag tag, size_t bytes, bool live) {
+    MemCounters &c = MemStats(tag);
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+    c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (!live) return;
+
+    int64_t now = c.liveBytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed) + bytes;
+    int64_t peak = c.peakBytes.load(std::memory_order_relaxed);
+    while (now > peak && !c.peakBytes.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+}
+
+void MemRecordFree(MemTag tag, size_t bytes, bool live) {
+    MemCounters &c = MemStats(tag);
+    c.frees.fetch_add(1, std::memory_order_relaxed);
+    if (live) c.liveBytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+}
+
+void MemReport() {
+    printf("[memory] %-8s %10s %10s %12s %10s %10s\n", "tag", "allocs", "frees", "requested", "live KB", "peak KB");
+    for (int i = 0; i < static_cast<int>(MemTag::COUNT); ++i) {
+        const MemCounters &c = counters[i];
+        printf("         %-8s %10llu %10llu %10.1f MB %10.1f %10.1f\n", TAG_NAMES[i],
+               static_cast<unsigned long long>(c.allocations.load()), static_cast<unsigned long long>(c.frees.load()),
+               c.bytes.load() / (1024.0 * 1024.0), c.liveBytes.load() / 1024.0, c.peakBytes.load() / 1024.0);
+    }
+    fflush(stdout);
+}
+
+MemScope::MemScope(MemTag tag) : previous(currentTag) { currentTag = tag; }
+
+MemScope::~MemScope() { currentTag = previous; }
+
+// ---- Tracked heap ----
+
+// Sits right before every pointer MemAlloc returns
+struct AllocHeader {
+    void *raw;
+    size_t size;
+    MemTag tag;
+};
+
+void *MemAlloc(size_t size, MemTag tag, size_t alignment) {
+    if (alignment < alignof(AllocHeader)) alignment = alignof(AllocHeader);
+    void *raw = malloc(size + sizeof(AllocHeader) + alignment - 1);
+    if (!raw) throw std::bad_alloc();
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw) + sizeof(AllocHeader);
+    uintptr_t aligned = (start + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+    AllocHeader *header = reinterpret_cast<AllocHeader *>(aligned) - 1;
+    header->raw = raw;
+    header->size = size;
+    header->tag = tag;
+
+    MemRecordAlloc(tag, size);
+    return reinterpret_cast<void *>(aligned);
+}
+
+void MemFree(void *pointer) {
+    if (!pointer) return;
+    AllocHeader *header = static_cast<AllocHeader *>(pointer) - 1;
+    MemRecordFree(header->tag, header->size);
+    free(header->raw);
+}
+
+// ---- Frame arena ----
+
+bool FrameArena::Init(size_t bytes) {
+    Release();
+    base = static_cast<unsigned char *>(MemAlloc(bytes, MemTag::Frame, 64));
+    capacity = bytes;
+    used.store(0, std::memory_order_relaxed);
+    highWater = 0;
+    return true;
+}
+
+void FrameArena::Release() {
+    Reset();
+    MemFree(base);
+    base = nullptr;
+    capacity = 0;
+}
+
+void *FrameArena::Alloc(size_t size, size_t alignment) {
+    size_t offset = used.load(std::memory_order_relaxed);
+    for (;;) {
+        uintptr_t address = reinterpret_cast<uintptr_t>(base) + offset;
+        size_t start = offset + ((alignment - address % alignment) % alignment);
+        if (start + size > capacity) break;
+        if (used.compare_exchange_weak(offset, start + size, std::memory_order_relaxed)) return base + start;
+    }
+
+    // Full: a heap block chained into the overflow list, with the link stored in front of the data
+    overflowCount.fetch_add(1, std::memory_order_relaxed);
+    size_t linkSize = (sizeof(void *) + alignment - 1) / alignment * alignment;
+    unsigned char *block = static_cast<unsigned char *>(MemAlloc(linkSize + size, MemTag::Frame, alignment));
+    void *head = overflow.load(std::memory_order_relaxed);
+    do {
+        *reinterpret_cast<void **>(block) = head;
+    } while (!overflow.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+    return block + linkSize;
+}
+
+void FrameArena::Reset() {
+    size_t inUse = used.exchange(0, std::memory_order_relaxed);
+    if (inUse > highWater) highWater = inUse;
+
+    void *block = overflow.exchange(nullptr, std::memory_order_acquire);
+    while (block) {
+        void *next = *static_cast<void **>(block);
+        MemFree(block);
+        block = next;
+    }
+}
+
+// ---- Global new/delete ----
+// Counted against the current thread's tag so allocations hiding in plain containers show up
+// in the per-frame count. Only counts and requested bytes: delete is not told the size.
+
+void *operator new(size_t size) {
+    MemRecordAlloc(currentTag, size, false);
+    if (void *p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    MemRecordAlloc(currentTag, size, false);
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept { return operator new(size, tag); }
+
+void operator delete(void *p) noexcept {
+    if (!p) return;
+    MemRecordFree(currentTag, 0, false);
+    free(p);
+}
+
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, size_t) noexcept { operator delete(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { operator delete(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { operator delete(p); }
+
+// Over-aligned types (alignas above the malloc guarantee) come through these. The block malloc
+// returned is stored right before the aligned pointer.
+static void *AlignedNew(size_t size, std::align_val_t alignment) noexcept {
+    size_t align = static_cast<size_t>(alignment);
+    if (align < alignof(void *)) align = alignof(void *);
+    MemRecordAlloc(currentTag, size, false);
+    void *raw = malloc(size + sizeof(void *) + align - 1);
+    if (!raw) return nullptr;
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw) + sizeof(void *);
+    uintptr_t aligned = (start + align - 1) & ~static_cast<uintptr_t>(align - 1);
+    reinterpret_cast<void **>(aligned)[-1] = raw;
+    return reinterpret_cast<void *>(aligned);
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    if (void *p = AlignedNew(size, alignment)) return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return AlignedNew(size, alignment);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return AlignedNew(size, alignment);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+    if (!p) return;
+    MemRecordFree(currentTag, 0, false);
+    free(static_cast<void **>(p)[-1]);
+}
+
+void operator delete[](void *p, std::align_val_t alignment) noexcept { operator delete(p, alignment); }
+void operator delete(void *p, size_t, std::align_val_t alignment) noexcept { operator delete(p, alignment); }
+void operator delete[](void *p, size_t, std::align_val_t alignment) noexcept { operator delete(p, alignment); }
+void operator delete(void *p, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    operator delete(p, alignment);
+}
+void operator delete[](void *p, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    operator delete(p, alignment);
+}
@@ -0,0 +1,147 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// Subsystem an allocation is charged to
+enum class MemTag : uint8_t { General, Render, Physics, Jobs, Frame, Entities, COUNT };
+
+// Per-tag counters. Every engine allocator reports here; plain new/delete is counted too,
+// against the calling thread's current tag (see MemScope).
+struct MemCounters {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> frees{0};
+    std::atomic<uint64_t> bytes{0};    // Total bytes ever requested
+    std::atomic<int64_t> liveBytes{0}; // Engine allocators only; plain delete does not know the size
+    std::atomic<int64_t> peakBytes{0};
+};
+
+MemCounters &MemStats(MemTag tag);
+const char *MemTagName(MemTag tag);
+uint64_t MemTotalAllocations(); // Heap allocations so far, all tags and threads
+void MemRecordAlloc(MemTag tag, size_t bytes, bool live = true);
+void MemRecordFree(MemTag tag, size_t bytes, bool live = true);
+void MemReport(); // Print the per-tag table to stdout
+
+// Charge plain new/delete on this thread to tag while in scope
+class MemScope {
+  public:
+    explicit MemScope(MemTag tag);
+    ~MemScope();
+
+  private:
+    MemTag previous;
+};
+
+// General tracked heap, any alignment up to 4096
+void *MemAlloc(size_t size, MemTag tag, size_t alignment = alignof(std::max_align_t));
+void MemFree(void *pointer);
+
+// Standard allocator over the tracked heap, for containers owned by a subsystem
+template <typename T, MemTag Tag> struct TaggedAllocator {
+    using value_type = T;
+    template <typename U> struct rebind {
+        using other = TaggedAllocator<U, Tag>;
+    };
+
+    TaggedAllocator() = default;
+    template <typename U> TaggedAllocator(const TaggedAllocator<U, Tag> &) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(MemAlloc(n * sizeof(T), Tag, alignof(T))); }
+    void deallocate(T *p, size_t) { MemFree(p); }
+
+    template <typename U> bool operator==(const TaggedAllocator<U, Tag> &) const { return true; }
+    template <typename U> bool operator!=(const TaggedAllocator<U, Tag> &) const { return false; }
+};
+
+template <typename T, MemTag Tag> using TaggedVector = std::vector<T, TaggedAllocator<T, Tag>>;
+
+// Linear allocator for data that lives for one frame. Allocation is a single atomic add, so jobs
+// may use it concurrently; Reset() at the end of the frame releases everything at once.
+// Running out falls back to the tracked heap (reported as overflow) until the next Reset.
+class FrameArena {
+  public:
+    ~FrameArena() { Release(); }
+
+    bool Init(size_t capacity);
+    void Release();
+
+    void *Alloc(size_t size, size_t alignment = alignof(std::max_align_t));
+    template <typename T> T *AllocArray(size_t count) {
+        return static_cast<T *>(Alloc(count * sizeof(T), alignof(T)));
+    }
+
+    void Reset(); // Main thread, no allocations in flight
+
+    size_t Used() const { return used.load(std::memory_order_relaxed); }
+    size_t Capacity() const { return capacity; }
+    size_t HighWater() const { return highWater; }
+    uint64_t Overflows() const { return overflowCount.load(std::memory_order_relaxed); }
+
+  private:
+    unsigned char *base = nullptr;
+    size_t capacity = 0;
+    std::atomic<size_t> used{0};
+    size_t highWater = 0;
+
+    // Heap blocks handed out after the arena filled up, freed at Reset
+    std::atomic<void *> overflow{nullptr};
+    std::atomic<uint64_t> overflowCount{0};
+};
+
+// Fixed-size object pool: blocks of BLOCK objects carved from the tracked heap, recycled through
+// an intrusive free list. Single-threaded; give each owner its own pool.
+template <typename T, MemTag Tag = MemTag::General, size_t BLOCK = 256> class ObjectPool {
+  public:
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+    ~ObjectPool() {
+        for (void *block : blocks) MemFree(block);
+    }
+
+    template <typename... Args> T *Create(Args &&...args) {
+        if (!freeList) Grow();
+        Slot *slot = freeList;
+        freeList = slot->next;
+        ++live;
+        return new (slot->storage) T(static_cast<Args &&>(args)...);
+    }
+
+    void Destroy(T *object) {
+        if (!object) return;
+        object->~T();
+        Slot *slot = reinterpret_cast<Slot *>(object);
+        slot->next = freeList;
+        freeList = slot;
+        --live;
+    }
+
+    size_t Live() const { return live; }
+    size_t Capacity() const { return blocks.size() * BLOCK; }
+
+  private:
+    union Slot {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    void Grow() {
+        Slot *block = static_cast<Slot *>(MemAlloc(sizeof(Slot) * BLOCK, Tag, alignof(Slot)));
+        blocks.push_back(block);
+        for (size_t i = BLOCK; i-- > 0;) {
+            block[i].next = freeList;
+            freeList = &block[i];
+        }
+    }
+
+    Slot *freeList = nullptr;
+    std::vector<void *> blocks;
+    size_t live = 0;
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include "Object.h"
+#include "Log.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+static const uint32_t COLUMN_ALIGNMENT = 64; // Every column starts on its own cache line
+
+// ---- Component registry ----
+
+static ComponentInfo componentInfos[MAX_COMPONENTS];
+static std::atomic<uint32_t> componentCount{0};
+
+ComponentId RegisterComponent(uint32_t size, uint32_t alignment) {
+    ComponentId id = componentCount.fetch_add(1);
+    if (id >= MAX_COMPONENTS) {
+        LOG_ERROR("More than {} component types", MAX_COMPONENTS);
+        std::abort();
+    }
+    componentInfos[id] = ComponentInfo{size, alignment};
+    return id;
+}
+
+const ComponentInfo &GetComponentInfo(ComponentId id) { return componentInfos[id]; }
+
+// ---- Archetypes ----
+
+EntityWorld::EntityWorld() { ArchetypeFor(0); }
+
+EntityWorld::~EntityWorld() {
+    for (Archetype *archetype : archetypes) {
+        for (const Chunk &chunk : archetype->chunks) MemFree(chunk.data);
+        delete archetype;
+    }
+    for (uint8_t *chunk : spareChunks) MemFree(chunk);
+}
+
+// Lay out a chunk for mask: the entity handles, then one aligned column per component in id
+// order, with as many rows as fit in CHUNK_BYTES
+uint32_t EntityWorld::ArchetypeFor(uint64_t mask) {
+    auto found = archetypeOf.find(mask);
+    if (found != archetypeOf.end()) return found->second;
+
+    Archetype *archetype = new Archetype();
+    archetype->mask = mask;
+    for (uint32_t i = 0; i < MAX_COMPONENTS; ++i) archetype->edges[i] = -1;
+    uint32_t rowBytes = sizeof(Entity);
+    for (ComponentId id = 0; id < MAX_COMPONENTS; ++id) {
+        if (!((mask >> id) & 1)) continue;
+        archetype->components.push_back(id);
+        rowBytes += GetComponentInfo(id).size;
+    }
+
+    auto layout = [&](uint32_t rows) {
+        uint32_t end = sizeof(Entity) * rows;
+        for (ComponentId id : archetype->components) {
+            uint32_t start = (end + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT;
+            archetype->offsets[id] = start;
+            end = start + GetComponentInfo(id).size * rows;
+        }
+        return end;
+    };
+    uint32_t capacity = CHUNK_BYTES / rowBytes;
+    while (capacity > 1 && layout(capacity) > CHUNK_BYTES) capacity--;
+    if (capacity == 0 || layout(capacity) > CHUNK_BYTES) {
+        LOG_ERROR("Components of {} bytes per entity do not fit a {} byte chunk", rowBytes, CHUNK_BYTES);
+        std::abort();
+    }
+    archetype->capacity = capacity;
+
+    uint32_t index = static_cast<uint32_t>(archetypes.size());
+    archetypes.push_back(archetype);
+    archetypeOf[mask] = index;
+    return index;
+}
+
+void EntityWorld::AppendRow(uint32_t index, Entity entity, uint32_t &chunk, uint32_t &row) {
+    Archetype &archetype = *archetypes[index];
+    if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity) {
+        uint8_t *data;
+        if (!spareChunks.empty()) {
+            data = spareChunks.back();
+            spareChunks.pop_back();
+        } else {
+            data = static_cast<uint8_t *>(MemAlloc(CHUNK_BYTES, MemTag::Entities, COLUMN_ALIGNMENT));
+        }
+        archetype.chunks.push_back(Chunk{data, 0});
+    }
+    chunk = static_cast<uint32_t>(archetype.chunks.size() - 1);
+    Chunk &last = archetype.chunks.back();
+    row = last.count++;
+    reinterpret_cast<Entity *>(last.data)[row] = entity;
+}
+
+void EntityWorld::RemoveRow(uint32_t index, uint32_t chunk, uint32_t row) {
+    Archetype &archetype = *archetypes[index];
+    Chunk &last = archetype.chunks.back();
+    uint32_t lastChunk = static_cast<uint32_t>(archetype.chunks.size() - 1), lastRow = last.count - 1;
+    if (chunk != lastChunk || row != lastRow) {
+        uint8_t *to = archetype.chunks[chunk].data, *from = last.data;
+        Entity moved = reinterpret_cast<Entity *>(from)[lastRow];
+        reinterpret_cast<Entity *>(to)[row] = moved;
+        for (ComponentId id : archetype.components) {
+            uint32_t size = GetComponentInfo(id).size;
+            memcpy(to + archetype.offsets[id] + size * row, from + archetype.offsets[id] + size * lastRow, size);
+        }
+        records[moved.index].chunk = chunk;
+        records[moved.index].row = row;
+    }
+    if (--last.count == 0) {
+        spareChunks.push_back(last.data);
+        archetype.chunks.pop_back();
+    }
+}
+
+// ---- Entities ----
+
+Entity EntityWorld::CreateIn(uint32_t archetype) {
+    Entity entity;
+    if (!freeIndices.empty()) {
+        entity.index = freeIndices.back();
+        freeIndices.pop_back();
+    } else {
+        entity.index = static_cast<uint32_t>(records.size());
+        records.push_back(Record{0, 0, 0, 1});
+    }
+    Record &record = records[entity.index];
+    entity.generation = record.generation;
+    record.archetype = archetype;
+    AppendRow(archetype, entity, record.chunk, record.row);
+    live++;
+    return entity;
+}
+
+Entity EntityWorld::Create() { return CreateIn(0); }
+
+void EntityWorld::Destroy(Entity entity) {
+    if (!IsAlive(entity)) return;
+    Record &record = records[entity.index];
+    RemoveRow(record.archetype, record.chunk, record.row);
+    if (++record.generation == 0) record.generation = 1; // 0 is never live
+    freeIndices.push_back(entity.index);
+    live--;
+}
+
+void EntityWorld::Clear() {
+    for (Archetype *archetype : archetypes) {
+        for (const Chunk &chunk : archetype->chunks) {
+            const Entity *entities = reinterpret_cast<const Entity *>(chunk.data);
+            for (uint32_t i = 0; i < chunk.count; ++i) {
+                Record &record = records[entities[i].index];
+                if (++record.generation == 0) record.generation = 1;
+                freeIndices.push_back(entities[i].index);
+            }
+            spareChunks.push_back(chunk.data);
+        }
+        archetype->chunks.clear();
+    }
+    live = 0;
+}
+
+void EntityWorld::Move(Entity entity, ComponentId id, bool add) {
+    Record &record = records[entity.index];
+    const uint32_t fromIndex = record.archetype;
+    if (archetypes[fromIndex]->edges[id] < 0)
+        archetypes[fromIndex]->edges[id] =
+            static_cast<int32_t>(ArchetypeFor(archetypes[fromIndex]->mask ^ (uint64_t(1) << id)));
+    const uint32_t toIndex = static_cast<uint32_t>(archetypes[fromIndex]->edges[id]);
+    const Archetype &from = *archetypes[fromIndex], &to = *archetypes[toIndex];
+
+    uint32_t chunk, row;
+    AppendRow(toIndex, entity, chunk, row);
+    // Components both archetypes have; an added one is left for the caller to fill
+    const Archetype &smaller = add ? from : to;
+    const uint8_t *source = from.chunks[record.chunk].data;
+    uint8_t *target = to.chunks[chunk].data;
+    for (ComponentId shared : smaller.components) {
+        uint32_t size = GetComponentInfo(shared).size;
+        memcpy(target + to.offsets[shared] + size * row, source + from.offsets[shared] + size * record.row, size);
+    }
+    RemoveRow(fromIndex, record.chunk, record.row);
+    record.archetype = toIndex;
+    record.chunk = chunk;
+    record.row = row;
+}
+
+size_t EntityWorld::ChunkCount() const {
+    size_t count = 0;
+    for (const Archetype *archetype : archetypes) count += archetype->chunks.size();
+    return count;
+}
@@ -0,0 +1,160 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include "Memory.h"
+
+#include <cstdint>
+#include <type_traits>
+#include <unordered_map>
+
+// Game objects are entities: a generational handle plus whatever components are attached, with no
+// class per kind of object.
+//
+// Entities with the same set of components share an archetype. An archetype stores them in 16 KB
+// chunks, each chunk holding one array per component (structure of arrays) plus their handles,
+// every array starting on a cache line. A query visits only the archetypes that have all of its
+// components and reads only those arrays, so a loop over two components of a million entities
+// streams exactly those two arrays through the cache.
+//
+// Components are plain data: trivially copyable, moved between chunks with memcpy. Adding or
+// removing a component moves the entity to another archetype; destroying one fills its row with
+// the archetype's last entity. Neither may happen while a query is iterating.
+
+struct Entity {
+    uint32_t index = 0;
+    uint32_t generation = 0; // Live entities start at 1, so a default Entity is never valid
+
+    bool operator==(const Entity &o) const { return index == o.index && generation == o.generation; }
+    bool operator!=(const Entity &o) const { return !(*this == o); }
+};
+
+typedef uint32_t ComponentId;
+static const ComponentId MAX_COMPONENTS = 64; // Component types across the program, one bit each in a signature
+
+// Component type registry, shared by every EntityWorld. Ids are handed out on first use.
+struct ComponentInfo {
+    uint32_t size, alignment;
+};
+ComponentId RegisterComponent(uint32_t size, uint32_t alignment);
+const ComponentInfo &GetComponentInfo(ComponentId id);
+
+template <typename T> ComponentId ComponentIdOf() {
+    static_assert(std::is_trivially_copyable<T>::value, "components are plain data, moved with memcpy");
+    static const ComponentId id = RegisterComponent(sizeof(T), alignof(T));
+    return id;
+}
+
+template <typename... Ts> uint64_t ComponentMask() {
+    return (uint64_t(0) | ... | (uint64_t(1) << ComponentIdOf<Ts>()));
+}
+
+class EntityWorld {
+  public:
+    static constexpr uint32_t CHUNK_BYTES = 16 * 1024;
+
+    EntityWorld();
+    ~EntityWorld();
+    EntityWorld(const EntityWorld &) = delete;
+    EntityWorld &operator=(const EntityWorld &) = delete;
+
+    // An entity with no components, or with the given ones in place
+    Entity Create();
+    template <typename... Ts> Entity Create(const Ts &...components) {
+        Entity entity = CreateIn(ArchetypeFor(ComponentMask<Ts...>()));
+        (void(*Get<Ts>(entity) = components), ...);
+        return entity;
+    }
+    void Destroy(Entity entity);
+    void Clear(); // Destroy every entity, keeping chunks for reuse
+    bool IsAlive(Entity entity) const {
+        return entity.index < records.size() && records[entity.index].generation == entity.generation;
+    }
+
+    // Add overwrites a component the entity already has and returns it, or null when the entity is
+    // dead. Remove ignores a component the entity does not have.
+    template <typename T> T *Add(Entity entity, const T &component = T()) {
+        if (!IsAlive(entity)) return nullptr;
+        if (!Has<T>(entity)) Move(entity, ComponentIdOf<T>(), true);
+        T *slot = Get<T>(entity);
+        *slot = component;
+        return slot;
+    }
+    template <typename T> void Remove(Entity entity) {
+        if (Has<T>(entity)) Move(entity, ComponentIdOf<T>(), false);
+    }
+    template <typename T> bool Has(Entity entity) const {
+        return IsAlive(entity) && ((archetypes[records[entity.index].archetype]->mask >> ComponentIdOf<T>()) & 1);
+    }
+    // Null when the entity is dead or lacks the component. Valid until the next structural change.
+    template <typename T> T *Get(Entity entity) {
+        if (!Has<T>(entity)) return nullptr;
+        const Record &record = records[entity.index];
+        const Archetype &archetype = *archetypes[record.archetype];
+        return reinterpret_cast<T *>(archetype.chunks[record.chunk].data + archetype.offsets[ComponentIdOf<T>()]) +
+               record.row;
+    }
+
+    // Call f(count, entities, Ts *...columns) for every chunk holding all of Ts, the columns being
+    // count contiguous components each. Other components of the chunk are not touched.
+    template <typename... Ts, typename F> void ForEachChunk(F &&f) {
+        const uint64_t mask = ComponentMask<Ts...>();
+        for (Archetype *archetype : archetypes) {
+            if ((archetype->mask & mask) != mask) continue;
+            for (const Chunk &chunk : archetype->chunks) {
+                if (chunk.count == 0) continue;
+                f(chunk.count, reinterpret_cast<const Entity *>(chunk.data),
+                  reinterpret_cast<Ts *>(chunk.data + archetype->offsets[ComponentIdOf<Ts>()])...);
+            }
+        }
+    }
+    // Call f(Ts &...) for every entity that has all of Ts
+    template <typename... Ts, typename F> void Each(F &&f) {
+        ForEachChunk<Ts...>([&](uint32_t count, const Entity *, Ts *...columns) {
+            for (uint32_t i = 0; i < count; ++i) f(columns[i]...);
+        });
+    }
+
+    size_t EntityCount() const { return live; }
+    size_t ArchetypeCount() const { return archetypes.size(); }
+    size_t ChunkCount() const;
+
+  private:
+    template <typename T> using Array = TaggedVector<T, MemTag::Entities>;
+
+    struct Chunk {
+        uint8_t *data;  // CHUNK_BYTES, entity handles first
+        uint32_t count; // Rows in use
+    };
+
+    struct Archetype {
+        uint64_t mask;
+        uint32_t capacity;                // Rows per chunk
+        uint32_t offsets[MAX_COMPONENTS]; // Column start within a chunk, for components in mask
+        int32_t edges[MAX_COMPONENTS];    // Archetype with that component toggled, -1 until first needed
+        Array<ComponentId> components;
+        Array<Chunk> chunks; // All full except the last
+    };
+
+    struct Record {
+        uint32_t archetype, chunk, row;
+        uint32_t generation;
+    };
+
+    uint32_t ArchetypeFor(uint64_t mask);
+    Entity CreateIn(uint32_t archetype);
+    // Append a row for entity to an archetype, returning where it went
+    void AppendRow(uint32_t archetype, Entity entity, uint32_t &chunk, uint32_t &row);
+    // Fill a row with the archetype's last one, which then no longer exists
+    void RemoveRow(uint32_t archetype, uint32_t chunk, uint32_t row);
+    // Move entity to the archetype with component id added or removed
+    void Move(Entity entity, ComponentId id, bool add);
+
+    Array<Archetype *> archetypes;
+    std::unordered_map<uint64_t, uint32_t> archetypeOf; // By mask
+    Array<Record> records;
+    Array<uint32_t> freeIndices;
+    Array<uint8_t *> spareChunks; // Emptied chunks, reused before allocating
+    size_t live = 0;
+};
+
+#endif
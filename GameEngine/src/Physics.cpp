@@ -0,0 +1,1334 @@
+#include "Physics.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Fixed-point builds stay scalar: the SSE paths are float only
+#if defined(__SSE2__) && !defined(PHYSICS_FIXED_POINT)
+#include <emmintrin.h>
+#define PHYSICS_SSE 1
+#endif
+
+static double Seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t PairKey(BodyId a, BodyId b) {
+    return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+}
+
+static const Vec3 PLANE_UP(0, 1, 0);        // Planes store their normal as the rotated +Y axis
+static const Real CLIP_TOLERANCE = 0.005f; // Box-box face clipping slack
+
+// Broad phase tuning
+static const uint32_t PAIR_GRAIN = 256;       // Bodies per pair-finding job
+static const size_t BATCH_REFIT_FRACTION = 4; // Refit instead of reinserting once 1/4 of the leaves moved
+static const Real REBUILD_AREA_GROWTH = 1.5f; // Rebuild once refits grew the tree's area ratio by this much
+
+// Solver tuning
+static const uint32_t COLOR_MIN_CONTACTS = 256; // Islands from this size are colored and solved across jobs
+static const uint32_t MAX_COLORS = 63;          // Manifolds that find no free color are solved serially last
+static const uint32_t MANIFOLD_GRAIN = 64;      // Manifolds per job within one color
+static const uint32_t BODY_GRAIN = 1024;        // Bodies per job for per-body passes
+
+// Query tuning
+static const uint32_t RAY_PACKET_GRAIN = 16; // Packets of four rays per job
+static const uint32_t OVERLAP_GRAIN = 32;    // Overlap queries per job
+
+PhysicsWorld::PhysicsWorld(const PhysicsConfig &config) : config(config) {}
+
+template <typename F> void PhysicsWorld::ForEachColumn(F &&f) {
+    f(px), f(py), f(pz), f(vx), f(vy), f(vz), f(wx), f(wy), f(wz), f(qx), f(qy), f(qz), f(qw);
+    f(invMass), f(active), f(sleepTime), f(sleepNext), f(invInertiaLocal), f(size), f(shape), f(friction),
+        f(restitution), f(bounds), f(proxy), f(ids);
+}
+
+template <typename F> void PhysicsWorld::ParallelFor(uint32_t count, uint32_t grain, const F &fn) const {
+    if (jobs) {
+        jobs->ParallelFor(count, grain, fn);
+        return;
+    }
+    for (uint32_t begin = 0; begin < count; begin += grain) fn(begin, std::min(begin + grain, count));
+}
+
+// ---- Bodies ----
+
+void PhysicsWorld::Reserve(size_t bodyCount) {
+    ForEachColumn([&](auto &column) { column.reserve(bodyCount); });
+    denseOf.reserve(bodyCount);
+    solverBodies.reserve(bodyCount);
+}
+
+BodyId PhysicsWorld::AddBody(const BodyDesc &desc) {
+    BodyId id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = static_cast<BodyId>(denseOf.size());
+        denseOf.push_back(INVALID_BODY);
+    }
+    denseOf[id] = static_cast<uint32_t>(ids.size());
+
+    Real mass = desc.shape == ShapeType::Plane ? Real(0) : desc.mass;
+    Real inverse = mass > Real(0) ? Real(1) / mass : Real(0);
+    Quat orientation = desc.shape == ShapeType::Plane ? RotationBetween(PLANE_UP, Normalize(desc.normal))
+                                                      : Normalize(desc.orientation);
+
+    // Solid sphere and box inertia
+    Vec3 extent = desc.shape == ShapeType::Box ? desc.halfExtents : Vec3(desc.radius, desc.radius, desc.radius);
+    Vec3 inertia;
+    if (desc.shape == ShapeType::Sphere) {
+        Real i = Real(0.4f) * mass * desc.radius * desc.radius;
+        inertia = Vec3(i, i, i);
+    } else {
+        Vec3 e2(extent.x * extent.x, extent.y * extent.y, extent.z * extent.z);
+        inertia = Vec3(e2.y + e2.z, e2.x + e2.z, e2.x + e2.y) * (mass / Real(3));
+    }
+    Vec3 inverseInertia;
+    if (inverse > Real(0)) inverseInertia = Vec3(Real(1) / inertia.x, Real(1) / inertia.y, Real(1) / inertia.z);
+
+    px.push_back(desc.position.x), py.push_back(desc.position.y), pz.push_back(desc.position.z);
+    // Static bodies never move, whatever the description says
+    Vec3 v = inverse > Real(0) ? desc.velocity : Vec3(), w = inverse > Real(0) ? desc.angularVelocity : Vec3();
+    vx.push_back(v.x), vy.push_back(v.y), vz.push_back(v.z);
+    wx.push_back(w.x), wy.push_back(w.y), wz.push_back(w.z);
+    qx.push_back(orientation.x), qy.push_back(orientation.y), qz.push_back(orientation.z), qw.push_back(orientation.w);
+    invMass.push_back(inverse);
+    active.push_back(inverse > Real(0) ? Real(1) : Real(0));
+    sleepTime.push_back(Real(0));
+    sleepNext.push_back(INVALID_BODY);
+    invInertiaLocal.push_back(inverseInertia);
+    size.push_back(extent);
+    shape.push_back(desc.shape);
+    friction.push_back(desc.friction);
+    restitution.push_back(desc.restitution);
+    bounds.push_back(Aabb());
+    proxy.push_back(AabbTree::NULL_NODE);
+    ids.push_back(id);
+
+    // Planes are unbounded and handled separately; static bodies go into a tree rebuilt only when
+    // they change, dynamic ones into the incrementally updated tree
+    uint32_t dense = denseOf[id];
+    if (desc.shape == ShapeType::Plane) {
+        planesDirty = true;
+    } else if (inverse > Real(0)) {
+        bounds[dense] = Bounds(dense);
+        proxy[dense] = dynamicTree.Insert(FatBounds(dense, Real(0)), id);
+        dynamicCount++;
+        awakeCount++;
+    } else {
+        bounds[dense] = Bounds(dense);
+        proxy[dense] = staticTree.Insert(bounds[dense], id);
+        staticTreeDirty = true;
+    }
+    return id;
+}
+
+void PhysicsWorld::RemoveBody(BodyId id) {
+    if (!IsValid(id)) return;
+    uint32_t dense = denseOf[id];
+    if (invMass[dense] > Real(0)) {
+        Wake(dense); // Its island may have been resting on it
+    } else if (shape[dense] == ShapeType::Plane) {
+        // Islands only link dynamic bodies, so wake whatever is within the broad-phase margin here
+        Vec3 n = Rotate(Orientation(dense), PLANE_UP);
+        Real d = Dot(n, Position(dense)) + config.aabbMargin;
+        for (uint32_t b = 0; b < ids.size(); ++b) {
+            const Aabb &box = bounds[b];
+            if (invMass[b] > Real(0) && Dot(n, box.Center()) - d <= Dot(Abs(n), (box.max - box.min) * Real(0.5f)))
+                Wake(b);
+        }
+    } else {
+        Aabb box = bounds[dense];
+        Vec3 margin(config.aabbMargin, config.aabbMargin, config.aabbMargin);
+        box.min -= margin;
+        box.max += margin;
+        dynamicTree.Query(box, [&](uint32_t other) {
+            uint32_t j = denseOf[other];
+            if (bounds[j].Overlaps(box)) Wake(j);
+            return true;
+        });
+    }
+
+    uint32_t last = static_cast<uint32_t>(ids.size() - 1);
+    if (shape[dense] == ShapeType::Plane) {
+        // Nothing to remove, the plane list is rebuilt below
+    } else if (invMass[dense] > Real(0)) {
+        dynamicTree.Remove(proxy[dense]);
+        dynamicCount--;
+        awakeCount--;
+    } else {
+        staticTree.Remove(proxy[dense]);
+    }
+
+    // Swap the last body into the hole
+    ForEachColumn([&](auto &column) {
+        column[dense] = column[last];
+        column.pop_back();
+    });
+    if (dense != last) denseOf[ids[dense]] = dense;
+    denseOf[id] = INVALID_BODY;
+    freeIds.push_back(id);
+
+    // Dense indices moved, so cached contacts and the plane list would point at the wrong bodies
+    contacts.clear();
+    planesDirty = true;
+}
+
+void PhysicsWorld::Clear() {
+    ForEachColumn([](auto &column) { column.clear(); });
+    denseOf.clear();
+    freeIds.clear();
+    contacts.clear();
+    previousContacts.clear();
+    dynamicTree.Clear();
+    staticTree.Clear();
+    dynamicCount = awakeCount = 0;
+    planesDirty = true;
+}
+
+Vec3 PhysicsWorld::GetPosition(BodyId id) const { return Position(denseOf[id]); }
+
+Quat PhysicsWorld::GetOrientation(BodyId id) const { return Orientation(denseOf[id]); }
+
+Vec3 PhysicsWorld::GetVelocity(BodyId id) const {
+    uint32_t i = denseOf[id];
+    return Vec3(vx[i], vy[i], vz[i]);
+}
+
+Vec3 PhysicsWorld::GetAngularVelocity(BodyId id) const {
+    uint32_t i = denseOf[id];
+    return Vec3(wx[i], wy[i], wz[i]);
+}
+
+void PhysicsWorld::SetVelocity(BodyId id, const Vec3 &velocity) {
+    uint32_t i = denseOf[id];
+    if (invMass[i] == Real(0)) return;
+    Wake(i);
+    sleepTime[i] = Real(0); // Moved, so it wakes whatever it runs into
+    vx[i] = velocity.x, vy[i] = velocity.y, vz[i] = velocity.z;
+}
+
+void PhysicsWorld::ApplyImpulse(BodyId id, const Vec3 &impulse, const Vec3 &point) {
+    uint32_t i = denseOf[id];
+    if (invMass[i] == Real(0)) return;
+    Wake(i);
+    sleepTime[i] = Real(0);
+    vx[i] += impulse.x * invMass[i], vy[i] += impulse.y * invMass[i], vz[i] += impulse.z * invMass[i];
+
+    Mat3 r = ToMatrix(Orientation(i));
+    Vec3 local = r.TransposeTimes(Cross(point - Position(i), impulse));
+    const Vec3 &inv = invInertiaLocal[i];
+    Vec3 dw = r * Vec3(local.x * inv.x, local.y * inv.y, local.z * inv.z);
+    wx[i] += dw.x, wy[i] += dw.y, wz[i] += dw.z;
+}
+
+// ---- Step ----
+
+void PhysicsWorld::Step(Real dt) {
+    if (dt <= Real(0)) return;
+    stats = PhysicsStepStats();
+    stats.bodies = static_cast<uint32_t>(ids.size());
+
+    double start = Seconds();
+    IntegrateVelocities(dt);
+    double integrated = Seconds();
+
+    FindFastBodies(dt);
+    BroadPhase();
+    double broad = Seconds();
+
+    NarrowPhase();
+    if (WakeContacted()) {
+        // The woken bodies need their own pairs and contacts this step, or they would not be pushed
+        BroadPhase();
+        contacts.swap(previousContacts); // Last step's contacts stay the warm start source
+        NarrowPhase();
+    }
+    double narrow = Seconds();
+
+    BuildIslands();
+    SolveContacts(dt);
+    UpdateSleep(dt);
+    double solved = Seconds();
+
+    IntegratePositions(dt);
+    double positioned = Seconds();
+    for (uint32_t i : fastBodies) speculativeMargin[i] = Real(0);
+
+    // Bounds and trees follow the new positions right away, so queries between steps see them
+    UpdateBounds();
+    UpdateTrees(dt);
+    double end = Seconds();
+
+    stats.pairs = static_cast<uint32_t>(pairs.size());
+    stats.contacts = static_cast<uint32_t>(contacts.size());
+    stats.awake = static_cast<uint32_t>(awakeCount);
+    stats.islands = static_cast<uint32_t>(islands.size());
+    stats.fast = static_cast<uint32_t>(fastBodies.size());
+    stats.broadPhaseTime = (broad - integrated) + (end - positioned);
+    stats.narrowPhaseTime = narrow - broad;
+    stats.solverTime = solved - narrow;
+    stats.integrateTime = (integrated - start) + (positioned - solved);
+}
+
+// Gravity and damping over the velocity columns, four bodies per instruction.
+// Static and sleeping bodies have zero velocity and a zero mask, so they come out unchanged.
+void PhysicsWorld::IntegrateVelocities(Real dt) {
+    const size_t n = ids.size();
+    const Real linear = Real(1) / (Real(1) + dt * config.linearDamping);
+    const Real angular = Real(1) / (Real(1) + dt * config.angularDamping);
+    const Vec3 g = config.gravity * dt;
+    size_t i = 0;
+#ifdef PHYSICS_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 gx = _mm_set1_ps(g.x), gy = _mm_set1_ps(g.y), gz = _mm_set1_ps(g.z);
+    const __m128 dampV = _mm_set1_ps(linear), dampW = _mm_set1_ps(angular);
+    for (; i + 4 <= n; i += 4) {
+        __m128 awake = _mm_cmpgt_ps(_mm_loadu_ps(&active[i]), zero);
+        _mm_storeu_ps(&vx[i], _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&vx[i]), _mm_and_ps(awake, gx)), dampV));
+        _mm_storeu_ps(&vy[i], _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&vy[i]), _mm_and_ps(awake, gy)), dampV));
+        _mm_storeu_ps(&vz[i], _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&vz[i]), _mm_and_ps(awake, gz)), dampV));
+        _mm_storeu_ps(&wx[i], _mm_mul_ps(_mm_loadu_ps(&wx[i]), dampW));
+        _mm_storeu_ps(&wy[i], _mm_mul_ps(_mm_loadu_ps(&wy[i]), dampW));
+        _mm_storeu_ps(&wz[i], _mm_mul_ps(_mm_loadu_ps(&wz[i]), dampW));
+    }
+#endif
+    for (; i < n; ++i) {
+        if (active[i] == Real(0)) continue;
+        vx[i] = (vx[i] + g.x) * linear, vy[i] = (vy[i] + g.y) * linear, vz[i] = (vz[i] + g.z) * linear;
+        wx[i] *= angular, wy[i] *= angular, wz[i] *= angular;
+    }
+}
+
+void PhysicsWorld::IntegratePositions(Real dt) {
+    const size_t n = ids.size();
+    size_t i = 0;
+#ifdef PHYSICS_SSE
+    const __m128 step = _mm_set1_ps(dt);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(&px[i], _mm_add_ps(_mm_loadu_ps(&px[i]), _mm_mul_ps(_mm_loadu_ps(&vx[i]), step)));
+        _mm_storeu_ps(&py[i], _mm_add_ps(_mm_loadu_ps(&py[i]), _mm_mul_ps(_mm_loadu_ps(&vy[i]), step)));
+        _mm_storeu_ps(&pz[i], _mm_add_ps(_mm_loadu_ps(&pz[i]), _mm_mul_ps(_mm_loadu_ps(&vz[i]), step)));
+    }
+#endif
+    for (; i < n; ++i) px[i] += vx[i] * dt, py[i] += vy[i] * dt, pz[i] += vz[i] * dt;
+
+    for (i = 0; i < n; ++i) {
+        if (active[i] == Real(0)) continue;
+        Quat q = Integrate(Orientation(i), Vec3(wx[i], wy[i], wz[i]), dt);
+        qx[i] = q.x, qy[i] = q.y, qz[i] = q.z, qw[i] = q.w;
+    }
+}
+
+// ---- Broad phase ----
+
+Aabb PhysicsWorld::Bounds(uint32_t i) const {
+    Vec3 c = Position(i);
+    Vec3 extent = size[i];
+    if (shape[i] == ShapeType::Box) {
+        // World extent of a rotated box: |R| * halfExtents
+        Mat3 r = ToMatrix(Orientation(i));
+        extent = Abs(r.c0) * extent.x + Abs(r.c1) * extent.y + Abs(r.c2) * extent.z;
+    }
+    return Aabb{c - extent, c + extent};
+}
+
+// Static and sleeping bodies keep the bounds they had
+void PhysicsWorld::UpdateBounds() {
+    for (uint32_t i = 0; i < ids.size(); ++i)
+        if (active[i] > Real(0)) bounds[i] = Bounds(i);
+}
+
+// Tree bounds: the tight box plus a margin, stretched along the body's motion so it stays
+// inside for a few steps
+Aabb PhysicsWorld::FatBounds(uint32_t i, Real dt) const {
+    Aabb box = bounds[i];
+    Vec3 margin(config.aabbMargin, config.aabbMargin, config.aabbMargin);
+    box.min -= margin;
+    box.max += margin;
+    Vec3 d = Vec3(vx[i], vy[i], vz[i]) * (dt * config.aabbPrediction);
+    box.min += Min(d, Vec3());
+    box.max += Max(d, Vec3());
+    return box;
+}
+
+void PhysicsWorld::RebuildPlanes() {
+    planes.clear();
+    for (uint32_t i = 0; i < ids.size(); ++i)
+        if (shape[i] == ShapeType::Plane) planes.push_back(i);
+    planesDirty = false;
+}
+
+// Planes from the cached list, or by scanning the bodies while that is out of date
+template <typename F> void PhysicsWorld::ForEachPlane(F &&f) const {
+    if (!planesDirty) {
+        for (uint32_t plane : planes) f(plane);
+        return;
+    }
+    for (uint32_t i = 0; i < ids.size(); ++i)
+        if (shape[i] == ShapeType::Plane) f(i);
+}
+
+// Bodies that left their fattened box get a new one. A handful are reinserted one by one; when a
+// large share of the tree moved at once (a scene load, an explosion) the leaves are enlarged in
+// place and the tree refit in one pass, with a full rebuild once that has degraded it too far.
+void PhysicsWorld::UpdateTrees(Real dt) {
+    if (staticTreeDirty) {
+        staticTree.Rebuild();
+        staticTreeDirty = false;
+    }
+
+    moved.clear();
+    for (uint32_t i = 0; i < ids.size(); ++i)
+        if (active[i] > Real(0) && !dynamicTree.GetFatBox(proxy[i]).Contains(bounds[i])) moved.push_back(i);
+    stats.reinserted = static_cast<uint32_t>(moved.size());
+
+    if (moved.size() * BATCH_REFIT_FRACTION < static_cast<size_t>(dynamicTree.LeafCount())) {
+        for (uint32_t i : moved) dynamicTree.Move(proxy[i], bounds[i], FatBounds(i, dt));
+        return;
+    }
+
+    for (uint32_t i : moved) dynamicTree.SetLeafBox(proxy[i], FatBounds(i, dt));
+    dynamicTree.Refit();
+    Real ratio = dynamicTree.AreaRatio();
+    if (ratio > REBUILD_AREA_GROWTH * rebuiltAreaRatio) {
+        dynamicTree.Rebuild();
+        rebuiltAreaRatio = dynamicTree.AreaRatio();
+    }
+}
+
+// Bodies about to move far relative to their size. Only these pay for continuous collision: a
+// box swept along this step's motion in the broad phase, and speculative contacts out to the
+// distance they travel.
+void PhysicsWorld::FindFastBodies(Real dt) {
+    fastBodies.clear();
+    sweptBounds.clear();
+    speculativeMargin.resize(ids.size(), Real(0)); // All zero between steps
+    if (config.ccdMotionThreshold <= Real(0)) return;
+
+    for (uint32_t i = 0; i < ids.size(); ++i) {
+        if (active[i] == Real(0)) continue;
+        Vec3 motion = Vec3(vx[i], vy[i], vz[i]) * dt;
+        const Vec3 &s = size[i];
+        Real extent = shape[i] == ShapeType::Box ? Min(s.x, Min(s.y, s.z)) : s.x;
+        Real limit = config.ccdMotionThreshold * extent;
+        if (LengthSquared(motion) <= limit * limit) continue;
+
+        fastBodies.push_back(i);
+        Aabb swept = bounds[i];
+        swept.min += Min(motion, Vec3());
+        swept.max += Max(motion, Vec3());
+        sweptBounds.push_back(swept);
+        speculativeMargin[i] = Length(motion);
+    }
+}
+
+void PhysicsWorld::BroadPhase() {
+    if (planesDirty) RebuildPlanes();
+    FindPairs();
+
+    // A pair with a sleeping body means something awake may touch its island. Wake it and look
+    // again, so the woken bodies get their own contacts this step instead of sagging for one.
+    while (WakeTouched()) FindPairs();
+}
+
+// Every awake body queries both trees with its tight box; chunks of bodies run as jobs, each
+// into its own buffer. A pair of awake bodies is found from both sides, only the lower id keeps it.
+void PhysicsWorld::FindPairs() {
+    pairs.clear();
+
+    const uint32_t count = static_cast<uint32_t>(ids.size());
+    const uint32_t chunks = (count + PAIR_GRAIN - 1) / PAIR_GRAIN;
+    if (pairBuffers.size() < chunks) pairBuffers.resize(chunks);
+
+    ParallelFor(count, PAIR_GRAIN, [&](uint32_t begin, uint32_t end) {
+        Array<uint64_t> &out = pairBuffers[begin / PAIR_GRAIN];
+        out.clear();
+        for (uint32_t i = begin; i < end; ++i) {
+            if (active[i] == Real(0)) continue;
+            const Aabb &box = bounds[i];
+            const BodyId self = ids[i];
+            dynamicTree.Query(box, [&](uint32_t other) {
+                uint32_t j = denseOf[other];
+                if ((other > self || active[j] == Real(0)) && bounds[j].Overlaps(box))
+                    out.push_back(PairKey(self, other));
+                return true;
+            });
+            staticTree.Query(box, [&](uint32_t other) {
+                if (bounds[denseOf[other]].Overlaps(box)) out.push_back(PairKey(self, other));
+                return true;
+            });
+        }
+    });
+
+    for (uint32_t chunk = 0; chunk < chunks; ++chunk)
+        pairs.insert(pairs.end(), pairBuffers[chunk].begin(), pairBuffers[chunk].end());
+
+    // Planes are unbounded; test them against each awake body's box directly
+    for (uint32_t plane : planes) {
+        Vec3 n = Rotate(Orientation(plane), PLANE_UP);
+        Real d = Dot(n, Position(plane));
+        for (uint32_t b = 0; b < count; ++b) {
+            if (active[b] == Real(0)) continue;
+            const Aabb &box = bounds[b];
+            if (Dot(n, box.Center()) - d <= Dot(Abs(n), (box.max - box.min) * Real(0.5f)))
+                pairs.push_back(PairKey(ids[plane], ids[b]));
+        }
+    }
+
+    if (!fastBodies.empty()) FindSweptPairs();
+
+    // Id order makes contact order, and so the solver, independent of how the jobs were scheduled
+    std::sort(pairs.begin(), pairs.end());
+    if (!fastBodies.empty()) pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+}
+
+// The other body's query only sees a fast body's tight box, so a fast body adds every pair along
+// its path itself, whatever the id order; the duplicates this makes are removed after sorting.
+void PhysicsWorld::FindSweptPairs() {
+    for (size_t f = 0; f < fastBodies.size(); ++f) {
+        const uint32_t i = fastBodies[f];
+        const Aabb &box = sweptBounds[f];
+        const BodyId self = ids[i];
+        auto add = [&](uint32_t other) {
+            if (other != self && bounds[denseOf[other]].Overlaps(box)) pairs.push_back(PairKey(self, other));
+            return true;
+        };
+        dynamicTree.Query(box, add);
+        staticTree.Query(box, add);
+        for (uint32_t plane : planes) {
+            Vec3 n = Rotate(Orientation(plane), PLANE_UP);
+            if (Dot(n, box.Center() - Position(plane)) <= Dot(Abs(n), (box.max - box.min) * Real(0.5f)))
+                pairs.push_back(PairKey(ids[plane], self));
+        }
+    }
+}
+
+// Only a body that moved last step wakes an island here. A slow one may merely have its box
+// overlap the island's, and waking for it would let two islands resting side by side put each
+// other back to sleep and wake each other forever. Its pair is kept all the same, and
+// WakeContacted wakes the island once the narrow phase finds the two really touch.
+bool PhysicsWorld::WakeTouched() {
+    bool woke = false;
+    for (uint64_t key : pairs) {
+        uint32_t a = denseOf[static_cast<BodyId>(key >> 32)], b = denseOf[static_cast<BodyId>(key & 0xffffffffu)];
+        if (invMass[a] > Real(0) && active[a] == Real(0) && sleepTime[b] == Real(0)) Wake(a), woke = true;
+        if (invMass[b] > Real(0) && active[b] == Real(0) && sleepTime[a] == Real(0)) Wake(b), woke = true;
+    }
+    return woke;
+}
+
+bool PhysicsWorld::WakeContacted() {
+    bool woke = false;
+    for (const Contact &c : contacts) {
+        if (invMass[c.a] > Real(0) && active[c.a] == Real(0)) Wake(c.a), woke = true;
+        if (invMass[c.b] > Real(0) && active[c.b] == Real(0)) Wake(c.b), woke = true;
+    }
+    return woke;
+}
+
+void PhysicsWorld::Wake(uint32_t i) {
+    if (invMass[i] == Real(0) || active[i] > Real(0)) return;
+    BodyId first = ids[i], id = first;
+    do {
+        uint32_t d = denseOf[id];
+        id = sleepNext[d];
+        active[d] = Real(1);
+        sleepTime[d] = Real(0);
+        sleepNext[d] = INVALID_BODY;
+        awakeCount++;
+    } while (id != first && id != INVALID_BODY);
+}
+
+// ---- Narrow phase ----
+
+void PhysicsWorld::NarrowPhase() {
+    // Last step's contacts become the warm start source
+    contacts.swap(previousContacts);
+    contacts.clear();
+    for (uint64_t key : pairs) {
+        uint32_t a = denseOf[static_cast<BodyId>(key >> 32)];
+        uint32_t b = denseOf[static_cast<BodyId>(key & 0xffffffffu)];
+        // Dispatch on the lower shape type first
+        if (shape[a] > shape[b]) std::swap(a, b);
+        const Real margin = speculativeMargin[a] + speculativeMargin[b];
+
+        switch (shape[a]) {
+        case ShapeType::Sphere:
+            if (shape[b] == ShapeType::Sphere) CollideSphereSphere(a, b, key, margin);
+            else if (shape[b] == ShapeType::Box) CollideSphereBox(a, b, key, margin);
+            else CollideSpherePlane(a, b, key, margin);
+            break;
+        case ShapeType::Box:
+            if (shape[b] == ShapeType::Box) CollideBoxBox(a, b, key, margin);
+            else CollideBoxPlane(a, b, key, margin);
+            break;
+        case ShapeType::Plane:
+            break;
+        }
+    }
+
+    // Carry accumulated impulses over from last step. Both lists are in pair key order.
+    size_t previous = 0;
+    for (Contact &c : contacts) {
+        while (previous < previousContacts.size() && previousContacts[previous].key < c.key) ++previous;
+        for (size_t p = previous; p < previousContacts.size() && previousContacts[p].key == c.key; ++p) {
+            const Contact &old = previousContacts[p];
+            if (old.feature != c.feature) continue;
+            c.normalImpulse = old.normalImpulse;
+            c.tangentImpulse1 = old.tangentImpulse1;
+            c.tangentImpulse2 = old.tangentImpulse2;
+            break;
+        }
+    }
+}
+
+void PhysicsWorld::AddContact(uint32_t a, uint32_t b, uint64_t key, uint32_t feature, const Vec3 &point,
+                              const Vec3 &normal, Real depth) {
+    Contact c;
+    c.a = a;
+    c.b = b;
+    c.key = key;
+    c.feature = feature;
+    c.point = point;
+    c.normal = normal;
+    c.depth = depth;
+    c.friction = Sqrt(friction[a] * friction[b]);
+    c.restitution = Max(restitution[a], restitution[b]);
+    c.normalImpulse = c.tangentImpulse1 = c.tangentImpulse2 = Real(0);
+    contacts.push_back(c);
+}
+
+void PhysicsWorld::CollideSphereSphere(uint32_t a, uint32_t b, uint64_t key, Real margin) {
+    Vec3 d = Position(b) - Position(a);
+    Real radii = size[a].x + size[b].x;
+    Real distance2 = LengthSquared(d);
+    if (distance2 > (radii + margin) * (radii + margin)) return;
+
+    Real distance = Sqrt(distance2);
+    Vec3 n = distance > Real(0) ? d * (Real(1) / distance) : Vec3(0, 1, 0);
+    Real depth = radii - distance;
+    AddContact(a, b, key, 0, Position(a) + n * (size[a].x - depth * Real(0.5f)), n, depth);
+}
+
+void PhysicsWorld::CollideSpherePlane(uint32_t a, uint32_t b, uint64_t key, Real margin) {
+    Vec3 n = Rotate(Orientation(b), PLANE_UP);
+    Vec3 c = Position(a);
+    Real distance = Dot(n, c - Position(b));
+    Real depth = size[a].x - distance;
+    if (depth < -margin) return;
+    AddContact(a, b, key, 0, c - n * (size[a].x - depth * Real(0.5f)), -n, depth);
+}
+
+void PhysicsWorld::CollideSphereBox(uint32_t a, uint32_t b, uint64_t key, Real margin) {
+    Mat3 r = ToMatrix(Orientation(b));
+    Vec3 center = Position(a);
+    Vec3 local = r.TransposeTimes(center - Position(b));
+    const Vec3 &h = size[b];
+    Real radius = size[a].x;
+
+    Vec3 closest(Clamp(local.x, -h.x, h.x), Clamp(local.y, -h.y, h.y), Clamp(local.z, -h.z, h.z));
+    Vec3 d = local - closest;
+    Real distance2 = LengthSquared(d);
+    if (distance2 > (radius + margin) * (radius + margin)) return;
+
+    Vec3 outward; // Box surface normal at the contact, local space
+    Real depth;
+    if (distance2 > Real(0)) {
+        Real distance = Sqrt(distance2);
+        outward = d * (Real(1) / distance);
+        depth = radius - distance;
+    } else {
+        // Center inside the box: push out through the nearest face
+        Vec3 gap(h.x - Abs(local.x), h.y - Abs(local.y), h.z - Abs(local.z));
+        int axis = gap.x < gap.y ? (gap.x < gap.z ? 0 : 2) : (gap.y < gap.z ? 1 : 2);
+        Real sign = local[axis] < Real(0) ? Real(-1) : Real(1);
+        outward = Vec3(axis == 0 ? sign : Real(0), axis == 1 ? sign : Real(0), axis == 2 ? sign : Real(0));
+        depth = radius + gap[axis];
+    }
+    Vec3 n = -(r * outward);
+    AddContact(a, b, key, 0, Position(b) + r * closest, n, depth);
+}
+
+void PhysicsWorld::CollideBoxPlane(uint32_t a, uint32_t b, uint64_t key, Real margin) {
+    Vec3 n = Rotate(Orientation(b), PLANE_UP);
+    Real d = Dot(n, Position(b));
+    Mat3 r = ToMatrix(Orientation(a));
+    Vec3 c = Position(a);
+    const Vec3 &h = size[a];
+
+    // Penetrating corners (or within margin of the plane), deepest four at most
+    struct Corner {
+        Vec3 point;
+        Real depth;
+        uint32_t index;
+    } corners[8];
+    int count = 0;
+    for (uint32_t i = 0; i < 8; ++i) {
+        Vec3 v = c + r.c0 * (i & 1 ? h.x : -h.x) + r.c1 * (i & 2 ? h.y : -h.y) + r.c2 * (i & 4 ? h.z : -h.z);
+        Real depth = d - Dot(n, v);
+        if (depth >= -margin) corners[count++] = Corner{v, depth, i};
+    }
+    if (count > 4) {
+        std::partial_sort(corners, corners + 4, corners + count,
+                          [](const Corner &x, const Corner &y) { return x.depth > y.depth; });
+        count = 4;
+    }
+    for (int i = 0; i < count; ++i)
+        AddContact(a, b, key, corners[i].index, corners[i].point + n * (corners[i].depth * Real(0.5f)), -n,
+                   corners[i].depth);
+}
+
+// Box-box by the separating axis test over 15 axes. Face axes clip the incident face against the
+// reference face's side planes; edge axes take the closest points of the two support edges.
+void PhysicsWorld::CollideBoxBox(uint32_t a, uint32_t b, uint64_t key, Real margin) {
+    const Mat3 ra = ToMatrix(Orientation(a)), rb = ToMatrix(Orientation(b));
+    const Vec3 ha = size[a], hb = size[b];
+    const Vec3 ca = Position(a), cb = Position(b);
+    const Vec3 d = cb - ca;
+
+    // Separation along unit axis L: > 0 means a gap
+    auto separation = [&](const Vec3 &axis) {
+        Real projA = ha.x * Abs(Dot(ra.c0, axis)) + ha.y * Abs(Dot(ra.c1, axis)) + ha.z * Abs(Dot(ra.c2, axis));
+        Real projB = hb.x * Abs(Dot(rb.c0, axis)) + hb.y * Abs(Dot(rb.c1, axis)) + hb.z * Abs(Dot(rb.c2, axis));
+        return Abs(Dot(d, axis)) - (projA + projB);
+    };
+
+    Real faceA = -REAL_HUGE, faceB = -REAL_HUGE, edge = -REAL_HUGE;
+    int faceAxisA = 0, faceAxisB = 0, edgeA = 0, edgeB = 0;
+    Vec3 edgeAxis;
+    for (int i = 0; i < 3; ++i) {
+        Real s = separation(ra.Column(i));
+        if (s > margin) return;
+        if (s > faceA) faceA = s, faceAxisA = i;
+    }
+    for (int i = 0; i < 3; ++i) {
+        Real s = separation(rb.Column(i));
+        if (s > margin) return;
+        if (s > faceB) faceB = s, faceAxisB = i;
+    }
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            Vec3 axis = Cross(ra.Column(i), rb.Column(j));
+            Real length = Length(axis);
+            if (length < Real(1e-4f)) continue; // Parallel edges, covered by the face axes
+            axis = axis * (Real(1) / length);
+            Real s = separation(axis);
+            if (s > margin) return;
+            if (s > edge) edge = s, edgeA = i, edgeB = j, edgeAxis = axis;
+        }
+    }
+
+    // Prefer faces unless an edge axis is clearly better; keeps manifolds stable for resting boxes.
+    // Apart (speculative), the axis with the largest gap is simply the true one.
+    const Real relative = Real(0.95f), absolute = Real(0.01f);
+    const Real face = Max(faceA, faceB);
+    if (face > Real(0) ? edge > face : edge > relative * face + absolute) {
+        Vec3 n = Dot(edgeAxis, d) < Real(0) ? -edgeAxis : edgeAxis; // From a to b
+
+        // Support edges: the edge of each box furthest along the normal towards the other box
+        Vec3 pointA = ca, pointB = cb;
+        for (int k = 0; k < 3; ++k) {
+            if (k != edgeA) pointA += ra.Column(k) * (Dot(ra.Column(k), n) > Real(0) ? ha[k] : -ha[k]);
+            if (k != edgeB) pointB += rb.Column(k) * (Dot(rb.Column(k), n) < Real(0) ? hb[k] : -hb[k]);
+        }
+        Vec3 ea = ra.Column(edgeA), eb = rb.Column(edgeB);
+
+        // Closest points between the two segments
+        Vec3 w = pointA - pointB;
+        Real bb = Dot(ea, eb), c = Dot(ea, w), f = Dot(eb, w);
+        Real denominator = Real(1) - bb * bb;
+        Real s = denominator > Real(1e-6f) ? (bb * f - c) / denominator : Real(0);
+        s = Clamp(s, -ha[edgeA], ha[edgeA]);
+        Real t = Clamp(bb * s + f, -hb[edgeB], hb[edgeB]);
+        s = Clamp(bb * t - c, -ha[edgeA], ha[edgeA]);
+
+        Vec3 onA = pointA + ea * s, onB = pointB + eb * t;
+        AddContact(a, b, key, 100 + edgeA * 3 + edgeB, (onA + onB) * Real(0.5f), n, -edge);
+        return;
+    }
+
+    // Face contact: the reference face belongs to the box whose face axis separated best
+    bool referenceIsA = !(faceB > relative * faceA + absolute * Real(0.1f));
+    const Mat3 &rr = referenceIsA ? ra : rb, &ri = referenceIsA ? rb : ra;
+    const Vec3 &hr = referenceIsA ? ha : hb, &hi = referenceIsA ? hb : ha;
+    const Vec3 &cr = referenceIsA ? ca : cb, &ci = referenceIsA ? cb : ca;
+    int axis = referenceIsA ? faceAxisA : faceAxisB;
+
+    Vec3 n = rr.Column(axis); // Reference face normal, towards the incident box
+    if (Dot(n, ci - cr) < Real(0)) n = -n;
+
+    // Incident face: the face of the other box most anti-parallel to n
+    int incident = 0;
+    Real most = Real(0);
+    for (int j = 0; j < 3; ++j) {
+        Real dot = Abs(Dot(ri.Column(j), n));
+        if (dot > most) most = dot, incident = j;
+    }
+    Vec3 incidentNormal = Dot(ri.Column(incident), n) > Real(0) ? -ri.Column(incident) : ri.Column(incident);
+    int u = (incident + 1) % 3, v = (incident + 2) % 3;
+    Vec3 faceCenter = ci + incidentNormal * hi[incident];
+    Vec3 du = ri.Column(u) * hi[u], dv = ri.Column(v) * hi[v];
+
+    // Polygon with a feature id per vertex: incident vertex index, or the clip plane that made it
+    struct ClipVertex {
+        Vec3 p;
+        uint32_t id;
+    };
+    ClipVertex polygon[8] = {{faceCenter + du + dv, 0}, {faceCenter - du + dv, 1}, {faceCenter - du - dv, 2},
+                             {faceCenter + du - dv, 3}};
+    int count = 4;
+
+    int r1 = (axis + 1) % 3, r2 = (axis + 2) % 3;
+    const Vec3 sideAxes[4] = {rr.Column(r1), -rr.Column(r1), rr.Column(r2), -rr.Column(r2)};
+    const Real sideExtents[4] = {hr[r1], hr[r1], hr[r2], hr[r2]};
+    for (int plane = 0; plane < 4 && count > 0; ++plane) {
+        ClipVertex clipped[8];
+        int out = 0;
+        Real limit = Dot(sideAxes[plane], cr) + sideExtents[plane];
+        for (int k = 0; k < count; ++k) {
+            const ClipVertex &p0 = polygon[k], &p1 = polygon[(k + 1) % count];
+            Real d0 = Dot(sideAxes[plane], p0.p) - limit, d1 = Dot(sideAxes[plane], p1.p) - limit;
+            // Vertices within the tolerance count as inside, so flush faces of equal boxes keep their
+            // corner features from step to step instead of trading them for clip points
+            if (d0 <= CLIP_TOLERANCE && out < 8) clipped[out++] = p0;
+            if (((d0 < Real(0) && d1 > CLIP_TOLERANCE) || (d0 > CLIP_TOLERANCE && d1 < Real(0))) && out < 8) {
+                Real t = d0 / (d0 - d1);
+                clipped[out++] = ClipVertex{p0.p + (p1.p - p0.p) * t, 4 + plane * 8 + p0.id};
+            }
+        }
+        count = out;
+        for (int k = 0; k < count; ++k) polygon[k] = clipped[k];
+    }
+
+    // Keep what is below the reference face, or within margin of it
+    Real referenceOffset = Dot(n, cr) + hr[axis];
+    ClipVertex points[8];
+    Real depths[8];
+    int kept = 0;
+    for (int k = 0; k < count; ++k) {
+        Real depth = referenceOffset - Dot(n, polygon[k].p);
+        if (depth >= -margin) {
+            points[kept] = polygon[k];
+            depths[kept++] = depth;
+        }
+    }
+
+    // More than four: keep the deepest, then the ones spreading the manifold out the most
+    int chosen[4];
+    int chosenCount = 0;
+    if (kept <= 4) {
+        for (int k = 0; k < kept; ++k) chosen[chosenCount++] = k;
+    } else {
+        int deepest = 0;
+        for (int k = 1; k < kept; ++k)
+            if (depths[k] > depths[deepest]) deepest = k;
+        chosen[chosenCount++] = deepest;
+        while (chosenCount < 4) {
+            int best = -1;
+            Real bestDistance = Real(-1);
+            for (int k = 0; k < kept; ++k) {
+                Real nearest = REAL_HUGE;
+                for (int c = 0; c < chosenCount; ++c)
+                    nearest = Min(nearest, LengthSquared(points[k].p - points[chosen[c]].p));
+                if (nearest > bestDistance) bestDistance = nearest, best = k;
+            }
+            chosen[chosenCount++] = best;
+        }
+    }
+
+    Vec3 normal = referenceIsA ? n : -n; // From a to b
+    uint32_t featureBase = (referenceIsA ? 0u : 1000u) + static_cast<uint32_t>(axis * 100 + incident * 40);
+    for (int k = 0; k < chosenCount; ++k) {
+        const ClipVertex &p = points[chosen[k]];
+        AddContact(a, b, key, featureBase + p.id, p.p + n * (depths[chosen[k]] * Real(0.5f)), normal,
+                   depths[chosen[k]]);
+    }
+}
+
+// ---- Islands ----
+
+static uint32_t FindRoot(uint32_t *parent, uint32_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]]; // Path halving
+        i = parent[i];
+    }
+    return i;
+}
+
+// Union-find over contacts between awake bodies. Static and sleeping bodies never join two islands:
+// anything can rest on the ground without the whole world becoming one island. Islands are numbered in
+// dense order of their first body and keep their contacts in contact order, so the result does not
+// depend on threads.
+void PhysicsWorld::BuildIslands() {
+    const uint32_t n = static_cast<uint32_t>(ids.size());
+    islandParent.resize(n);
+    islandOf.resize(n);
+    uint32_t *parent = islandParent.data();
+    for (uint32_t i = 0; i < n; ++i) parent[i] = i;
+
+    for (const Contact &c : contacts) {
+        if (active[c.a] == Real(0) || active[c.b] == Real(0)) continue;
+        uint32_t ra = FindRoot(parent, c.a), rb = FindRoot(parent, c.b);
+        if (ra != rb) parent[std::max(ra, rb)] = std::min(ra, rb);
+    }
+
+    islands.clear();
+    for (uint32_t i = 0; i < n; ++i) {
+        if (active[i] == Real(0) || FindRoot(parent, i) != i) continue;
+        islandOf[i] = static_cast<uint32_t>(islands.size());
+        islands.push_back(Island{0, 0, 0, 0});
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        if (active[i] == Real(0)) continue;
+        islandOf[i] = islandOf[FindRoot(parent, i)];
+        islands[islandOf[i]].bodyCount++;
+    }
+    for (const Contact &c : contacts) islands[islandOf[active[c.a] > Real(0) ? c.a : c.b]].contactCount++;
+
+    // Counting sort of bodies and contacts by island
+    uint32_t bodyOffset = 0, contactOffset = 0;
+    for (Island &island : islands) {
+        island.bodyBegin = bodyOffset;
+        island.contactBegin = contactOffset;
+        bodyOffset += island.bodyCount;
+        contactOffset += island.contactCount;
+        island.bodyCount = island.contactCount = 0;
+    }
+    islandBodies.resize(bodyOffset);
+    islandContacts.resize(contactOffset);
+    for (uint32_t i = 0; i < n; ++i) {
+        if (active[i] == Real(0)) continue;
+        Island &island = islands[islandOf[i]];
+        islandBodies[island.bodyBegin + island.bodyCount++] = i;
+    }
+    for (uint32_t k = 0; k < contacts.size(); ++k) {
+        const Contact &c = contacts[k];
+        Island &island = islands[islandOf[active[c.a] > Real(0) ? c.a : c.b]];
+        islandContacts[island.contactBegin + island.contactCount++] = k;
+    }
+}
+
+// An island sleeps once every body in it has been slow for timeToSleep. Sleeping bodies are
+// linked in a ring so touching any of them wakes the island as a whole.
+void PhysicsWorld::UpdateSleep(Real dt) {
+    if (!config.allowSleep) return;
+    const Real linear2 = config.sleepLinearVelocity * config.sleepLinearVelocity;
+    const Real angular2 = config.sleepAngularVelocity * config.sleepAngularVelocity;
+
+    for (const Island &island : islands) {
+        Real minSleepTime = REAL_HUGE;
+        for (uint32_t k = 0; k < island.bodyCount; ++k) {
+            uint32_t i = islandBodies[island.bodyBegin + k];
+            Real v2 = vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i];
+            Real w2 = wx[i] * wx[i] + wy[i] * wy[i] + wz[i] * wz[i];
+            sleepTime[i] = v2 > linear2 || w2 > angular2 ? Real(0) : sleepTime[i] + dt;
+            minSleepTime = Min(minSleepTime, sleepTime[i]);
+        }
+        if (minSleepTime < config.timeToSleep) continue;
+
+        for (uint32_t k = 0; k < island.bodyCount; ++k) {
+            uint32_t i = islandBodies[island.bodyBegin + k];
+            uint32_t next = islandBodies[island.bodyBegin + (k + 1) % island.bodyCount];
+            vx[i] = vy[i] = vz[i] = wx[i] = wy[i] = wz[i] = Real(0);
+            active[i] = Real(0);
+            sleepNext[i] = ids[next];
+        }
+        awakeCount -= island.bodyCount;
+    }
+}
+
+// ---- Solver ----
+
+// Static bodies are never written, so jobs solving different manifolds can share them
+static inline void ApplySolverImpulse(Vec3 &v, Vec3 &w, Real invMass, const Mat3 &invInertia, const Vec3 &r,
+                                      const Vec3 &impulse) {
+    if (invMass == Real(0)) return;
+    v += impulse * invMass;
+    w += invInertia * Cross(r, impulse);
+}
+
+static inline Real EffectiveMass(Real invMassA, const Mat3 &invInertiaA, const Vec3 &rA, Real invMassB,
+                                 const Mat3 &invInertiaB, const Vec3 &rB, const Vec3 &axis) {
+    Vec3 ra = Cross(rA, axis), rb = Cross(rB, axis);
+    Real k = invMassA + invMassB + Dot(ra, invInertiaA * ra) + Dot(rb, invInertiaB * rb);
+    return k > Real(0) ? Real(1) / k : Real(0);
+}
+
+// Lever arms, effective masses and velocity bias; reads bodies only
+void PhysicsWorld::PrepareContact(Contact &c, Real inverseDt) {
+    const SolverBody &A = solverBodies[c.a], &B = solverBodies[c.b];
+    c.rA = c.point - Position(c.a);
+    c.rB = c.point - Position(c.b);
+    Tangents(c.normal, c.tangent1, c.tangent2);
+    c.normalMass = EffectiveMass(A.invMass, A.invInertia, c.rA, B.invMass, B.invInertia, c.rB, c.normal);
+    c.tangentMass1 = EffectiveMass(A.invMass, A.invInertia, c.rA, B.invMass, B.invInertia, c.rB, c.tangent1);
+    c.tangentMass2 = EffectiveMass(A.invMass, A.invInertia, c.rA, B.invMass, B.invInertia, c.rB, c.tangent2);
+
+    Vec3 relative = B.v + Cross(B.w, c.rB) - A.v - Cross(A.w, c.rA);
+    Real closing = Dot(relative, c.normal);
+    if (c.depth < Real(0)) {
+        // Speculative: the bodies may close the gap this step, but no more. No bounce until they touch.
+        c.bias = c.depth * inverseDt;
+        return;
+    }
+    c.bias = config.baumgarte * inverseDt * Max(Real(0), c.depth - config.allowedPenetration);
+    if (closing < -config.restitutionThreshold) c.bias = Max(c.bias, -c.restitution * closing);
+}
+
+// Apply last step's impulses up front
+void PhysicsWorld::WarmStartContact(Contact &c) {
+    SolverBody &A = solverBodies[c.a], &B = solverBodies[c.b];
+    Vec3 impulse = c.normal * c.normalImpulse + c.tangent1 * c.tangentImpulse1 + c.tangent2 * c.tangentImpulse2;
+    ApplySolverImpulse(A.v, A.w, A.invMass, A.invInertia, c.rA, -impulse);
+    ApplySolverImpulse(B.v, B.w, B.invMass, B.invInertia, c.rB, impulse);
+}
+
+void PhysicsWorld::SolveContact(Contact &c) {
+    SolverBody &A = solverBodies[c.a], &B = solverBodies[c.b];
+
+    // Friction, bounded by the current normal impulse
+    Real limit = c.friction * c.normalImpulse;
+    Vec3 relative = B.v + Cross(B.w, c.rB) - A.v - Cross(A.w, c.rA);
+    Real lambda1 = -c.tangentMass1 * Dot(relative, c.tangent1);
+    Real lambda2 = -c.tangentMass2 * Dot(relative, c.tangent2);
+    Real old1 = c.tangentImpulse1, old2 = c.tangentImpulse2;
+    c.tangentImpulse1 = Clamp(old1 + lambda1, -limit, limit);
+    c.tangentImpulse2 = Clamp(old2 + lambda2, -limit, limit);
+    Vec3 impulse = c.tangent1 * (c.tangentImpulse1 - old1) + c.tangent2 * (c.tangentImpulse2 - old2);
+    ApplySolverImpulse(A.v, A.w, A.invMass, A.invInertia, c.rA, -impulse);
+    ApplySolverImpulse(B.v, B.w, B.invMass, B.invInertia, c.rB, impulse);
+
+    // Normal, accumulated impulse never pulls
+    relative = B.v + Cross(B.w, c.rB) - A.v - Cross(A.w, c.rA);
+    Real lambda = c.normalMass * (c.bias - Dot(relative, c.normal));
+    Real old = c.normalImpulse;
+    c.normalImpulse = Max(old + lambda, Real(0));
+    impulse = c.normal * (c.normalImpulse - old);
+    ApplySolverImpulse(A.v, A.w, A.invMass, A.invInertia, c.rA, -impulse);
+    ApplySolverImpulse(B.v, B.w, B.invMass, B.invInertia, c.rB, impulse);
+}
+
+void PhysicsWorld::SolveIsland(const Island &island, Real inverseDt) {
+    const uint32_t *order = islandContacts.data() + island.contactBegin;
+    for (uint32_t k = 0; k < island.contactCount; ++k) PrepareContact(contacts[order[k]], inverseDt);
+    for (uint32_t k = 0; k < island.contactCount; ++k) WarmStartContact(contacts[order[k]]);
+    for (int iteration = 0; iteration < config.velocityIterations; ++iteration)
+        for (uint32_t k = 0; k < island.contactCount; ++k) SolveContact(contacts[order[k]]);
+}
+
+// A large island is split into manifolds (all contacts of one body pair) and colored greedily so
+// no two manifolds of a color share a dynamic body. Each color is then solved across jobs, colors
+// one after another. It is still Gauss-Seidel, in a different but fixed order.
+void PhysicsWorld::SolveColored(const Island &island, Real inverseDt) {
+    const uint32_t *order = islandContacts.data() + island.contactBegin;
+
+    manifoldBegin.clear();
+    for (uint32_t k = 0; k < island.contactCount; ++k)
+        if (k == 0 || contacts[order[k]].key != contacts[order[k - 1]].key) manifoldBegin.push_back(k);
+    const uint32_t manifoldCount = static_cast<uint32_t>(manifoldBegin.size());
+    manifoldBegin.push_back(island.contactCount);
+
+    for (uint32_t k = 0; k < island.bodyCount; ++k) colorMask[islandBodies[island.bodyBegin + k]] = 0;
+    manifoldColor.resize(manifoldCount);
+    colorStart.assign(MAX_COLORS + 2, 0);
+    for (uint32_t m = 0; m < manifoldCount; ++m) {
+        const Contact &c = contacts[order[manifoldBegin[m]]];
+        bool dynamicA = active[c.a] > Real(0), dynamicB = active[c.b] > Real(0);
+        uint64_t used = (dynamicA ? colorMask[c.a] : 0) | (dynamicB ? colorMask[c.b] : 0);
+        uint32_t color = 0;
+        while (color < MAX_COLORS && (used >> color) & 1) ++color;
+        if (color < MAX_COLORS) {
+            if (dynamicA) colorMask[c.a] |= uint64_t(1) << color;
+            if (dynamicB) colorMask[c.b] |= uint64_t(1) << color;
+        }
+        manifoldColor[m] = static_cast<uint8_t>(color);
+        colorStart[color + 1]++;
+    }
+    for (uint32_t color = 0; color <= MAX_COLORS; ++color) colorStart[color + 1] += colorStart[color];
+    coloredManifolds.resize(manifoldCount);
+    for (uint32_t m = 0; m < manifoldCount; ++m) coloredManifolds[colorStart[manifoldColor[m]]++] = m;
+    for (uint32_t color = MAX_COLORS + 1; color > 0; --color) colorStart[color] = colorStart[color - 1];
+    colorStart[0] = 0;
+
+    uint32_t colors = 0;
+    while (colors < MAX_COLORS && colorStart[colors + 1] > colorStart[colors]) ++colors;
+    stats.colors = std::max(stats.colors, colors);
+
+    ParallelFor(island.contactCount, MANIFOLD_GRAIN * 4,
+                [&](uint32_t begin, uint32_t end) {
+                    for (uint32_t k = begin; k < end; ++k) PrepareContact(contacts[order[k]], inverseDt);
+                });
+
+    // Manifolds of one color touch disjoint bodies; the overflow bucket goes last on this thread
+    auto solveColors = [&](bool warmStart) {
+        for (uint32_t color = 0; color <= MAX_COLORS; ++color) {
+            uint32_t first = colorStart[color], count = colorStart[color + 1] - first;
+            auto solve = [&](uint32_t begin, uint32_t end) {
+                for (uint32_t m = begin; m < end; ++m) {
+                    uint32_t manifold = coloredManifolds[first + m];
+                    for (uint32_t k = manifoldBegin[manifold]; k < manifoldBegin[manifold + 1]; ++k) {
+                        if (warmStart)
+                            WarmStartContact(contacts[order[k]]);
+                        else
+                            SolveContact(contacts[order[k]]);
+                    }
+                }
+            };
+            if (color < MAX_COLORS)
+                ParallelFor(count, MANIFOLD_GRAIN, solve);
+            else
+                solve(0, count);
+        }
+    };
+    solveColors(true);
+    for (int iteration = 0; iteration < config.velocityIterations; ++iteration) solveColors(false);
+}
+
+void PhysicsWorld::SolveContacts(Real dt) {
+    const uint32_t n = static_cast<uint32_t>(ids.size());
+    const Real inverseDt = Real(1) / dt;
+    solverBodies.resize(n);
+    colorMask.resize(n);
+
+    ParallelFor(n, BODY_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            SolverBody &body = solverBodies[i];
+            body.v = Vec3(vx[i], vy[i], vz[i]);
+            body.w = Vec3(wx[i], wy[i], wz[i]);
+            if (active[i] == Real(0)) {
+                // Static or asleep, immovable either way
+                body.invMass = Real(0);
+                body.invInertia = Mat3();
+                continue;
+            }
+            body.invMass = invMass[i];
+
+            // R * diag(invI) * R^T
+            Mat3 r = ToMatrix(Orientation(i));
+            const Vec3 &d = invInertiaLocal[i];
+            Vec3 s0 = r.c0 * d.x, s1 = r.c1 * d.y, s2 = r.c2 * d.z;
+            body.invInertia = Mat3(s0 * r.c0.x + s1 * r.c1.x + s2 * r.c2.x, s0 * r.c0.y + s1 * r.c1.y + s2 * r.c2.y,
+                                   s0 * r.c0.z + s1 * r.c1.z + s2 * r.c2.z);
+        }
+    });
+
+    // Large islands one at a time with their colors spread over jobs, then the small ones as jobs
+    smallIslands.clear();
+    for (uint32_t k = 0; k < islands.size(); ++k) {
+        if (islands[k].contactCount >= COLOR_MIN_CONTACTS)
+            SolveColored(islands[k], inverseDt);
+        else if (islands[k].contactCount > 0)
+            smallIslands.push_back(k);
+    }
+    const uint32_t smallCount = static_cast<uint32_t>(smallIslands.size());
+    ParallelFor(smallCount, std::max(1u, smallCount / 64), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t k = begin; k < end; ++k) SolveIsland(islands[smallIslands[k]], inverseDt);
+    });
+    stats.iterations = static_cast<uint32_t>(config.velocityIterations);
+
+    ParallelFor(n, BODY_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            if (active[i] == Real(0)) continue;
+            const SolverBody &body = solverBodies[i];
+            vx[i] = body.v.x, vy[i] = body.v.y, vz[i] = body.v.z;
+            wx[i] = body.w.x, wy[i] = body.w.y, wz[i] = body.w.z;
+        }
+    });
+}
+
+// ---- Queries ----
+
+// Direction component to its reciprocal, with a huge finite stand-in for zero so slab tests
+// never multiply zero by infinity
+static Real SafeInverse(Real x) {
+    if (Abs(x) > Real(1e-30f)) return Real(1) / x;
+    return x < Real(0) ? -REAL_HUGE : REAL_HUGE;
+}
+
+// Distance along a unit direction to where the ray enters a sphere. Rays starting inside miss.
+static bool RaySphere(const Vec3 &o, const Vec3 &d, const Vec3 &center, Real radius, Real &t) {
+    Vec3 m = o - center;
+    Real b = Dot(m, d), c = Dot(m, m) - radius * radius;
+    if (c <= Real(0) || b > Real(0)) return false; // Inside, or outside and heading away
+    Real disc = b * b - c;
+    if (disc < Real(0)) return false;
+    t = -b - Sqrt(disc);
+    return true;
+}
+
+// Same for the capsule around segment a-b: its cylinder side, then its end spheres
+static bool RayCapsule(const Vec3 &o, const Vec3 &d, const Vec3 &a, const Vec3 &b, Real radius, Real &t) {
+    Vec3 axis = b - a, m = o - a;
+    Real aa = Dot(axis, axis), ad = Dot(axis, d), am = Dot(axis, m);
+    Real k = aa - ad * ad; // aa times the squared length of d across the axis
+    bool hit = false;
+    if (k > Real(1e-6f) * aa) {
+        Real h = aa * Dot(m, d) - am * ad;
+        Real c = aa * (Dot(m, m) - radius * radius) - am * am;
+        Real disc = h * h - k * c;
+        if (c > Real(0) && h < Real(0) && disc >= Real(0)) {
+            Real s = (-h - Sqrt(disc)) / k;
+            Real along = am + s * ad;
+            if (along >= Real(0) && along <= aa) t = s, hit = true;
+        }
+    }
+    Real ts;
+    if (RaySphere(o, d, a, radius, ts) && (!hit || ts < t)) t = ts, hit = true;
+    if (RaySphere(o, d, b, radius, ts) && (!hit || ts < t)) t = ts, hit = true;
+    return hit;
+}
+
+// Exact cast of a ray or swept sphere against body i. Fills hit and returns true only for a hit
+// no further than maxDistance.
+bool PhysicsWorld::CastShape(uint32_t i, const Vec3 &origin, const Vec3 &direction, Real radius, Real maxDistance,
+                             RayHit &hit) const {
+    Real t;
+    Vec3 normal;
+    if (shape[i] == ShapeType::Sphere) {
+        if (!RaySphere(origin, direction, Position(i), size[i].x + radius, t) || t > maxDistance) return false;
+        normal = Normalize(origin + direction * t - Position(i));
+    } else if (shape[i] == ShapeType::Plane) {
+        Vec3 n = Rotate(Orientation(i), PLANE_UP);
+        Real height = Dot(n, origin - Position(i)) - radius, speed = Dot(n, direction);
+        if (height < Real(0) || speed >= Real(0)) return false;
+        t = -height / speed;
+        if (t > maxDistance) return false;
+        normal = n;
+    } else {
+        // In box space, against the box grown by radius on every side. Where that entry point
+        // lies past an edge or corner of the real box, the swept sphere actually meets the
+        // rounded edge there, so the capsules along those edges give the true distance.
+        Mat3 r = ToMatrix(Orientation(i));
+        Vec3 o = r.TransposeTimes(origin - Position(i)), d = r.TransposeTimes(direction);
+        const Vec3 &e = size[i];
+        Real tNear = Real(0), tFar = maxDistance;
+        int axis = -1;
+        for (int k = 0; k < 3; ++k) {
+            Real grown = e[k] + radius;
+            if (Abs(d[k]) < Real(1e-6f)) {
+                if (o[k] < -grown || o[k] > grown) return false;
+                continue;
+            }
+            Real inv = Real(1) / d[k];
+            Real t1 = (-grown - o[k]) * inv, t2 = (grown - o[k]) * inv;
+            if (t1 > t2) std::swap(t1, t2);
+            if (axis < 0 || t1 > tNear) tNear = t1, axis = k;
+            tFar = Min(tFar, t2);
+        }
+        if (axis < 0 || tNear > tFar) return false;
+
+        t = Max(tNear, Real(0));
+        Vec3 p = o + d * t;
+        uint32_t outside = 0, positive = 0;
+        if (radius > Real(0)) {
+            for (int k = 0; k < 3; ++k) {
+                if (p[k] < -e[k]) outside |= 1u << k;
+                if (p[k] > e[k]) outside |= 1u << k, positive |= 1u << k;
+            }
+        }
+
+        Vec3 localNormal;
+        if (outside == 0 || outside == 1 || outside == 2 || outside == 4) {
+            if (tNear < Real(0)) return false; // Started inside
+            Real n[3] = {0, 0, 0};
+            n[axis] = d[axis] > Real(0) ? Real(-1) : Real(1);
+            localNormal = Vec3(n[0], n[1], n[2]);
+        } else {
+            auto corner = [&](uint32_t plus) {
+                return Vec3(plus & 1u ? e.x : -e.x, plus & 2u ? e.y : -e.y, plus & 4u ? e.z : -e.z);
+            };
+            bool hitEdge = false;
+            for (int k = 0; k < 3; ++k) {
+                // Edges along axis k that touch the region the entry point is in
+                uint32_t bit = 1u << k;
+                if (outside != 7u && (outside & bit)) continue;
+                Real te;
+                if (RayCapsule(o, d, corner(positive & ~bit), corner(positive | bit), radius, te) &&
+                    (!hitEdge || te < t))
+                    t = te, hitEdge = true;
+            }
+            if (!hitEdge || t > maxDistance) return false;
+            Vec3 center = o + d * t;
+            localNormal = Normalize(center - Max(Min(center, e), -e));
+        }
+        normal = r * localNormal;
+    }
+
+    hit.body = ids[i];
+    hit.distance = t;
+    hit.normal = normal;
+    hit.point = origin + direction * t - normal * radius;
+    return true;
+}
+
+void PhysicsWorld::CastPacket(const RayCast *rays, uint32_t count, RayHit *hits) const {
+    AabbTree::RayPacket packet;
+    Vec3 directions[4];
+    uint32_t mask = 0;
+    for (uint32_t lane = 0; lane < 4; ++lane) {
+        const RayCast &ray = rays[lane < count ? lane : 0]; // Spare lanes copy the first and stay masked off
+        Vec3 d = directions[lane] = Normalize(ray.direction);
+        packet.ox[lane] = ray.origin.x, packet.oy[lane] = ray.origin.y, packet.oz[lane] = ray.origin.z;
+        packet.invDx[lane] = SafeInverse(d.x), packet.invDy[lane] = SafeInverse(d.y);
+        packet.invDz[lane] = SafeInverse(d.z);
+        packet.radius[lane] = ray.radius;
+        packet.maxT[lane] = ray.maxDistance;
+        if (lane < count) {
+            mask |= 1u << lane;
+            hits[lane] = RayHit();
+        }
+    }
+
+    // Each hit shortens its lane, so later leaves only count if they are closer; an any-hit lane
+    // is retired instead
+    auto visit = [&](BodyId id, uint32_t lanes) {
+        uint32_t i = denseOf[id];
+        for (uint32_t lane = 0; lane < count; ++lane) {
+            const RayCast &ray = rays[lane];
+            if (!(lanes & (1u << lane)) || id == ray.ignore) continue;
+            if (!CastShape(i, ray.origin, directions[lane], ray.radius, packet.maxT[lane], hits[lane])) continue;
+            packet.maxT[lane] = ray.anyHit ? Real(-1) : hits[lane].distance;
+        }
+    };
+    dynamicTree.CastPacket(packet, mask, visit);
+    staticTree.CastPacket(packet, mask, visit);
+    ForEachPlane([&](uint32_t plane) { visit(ids[plane], mask); });
+}
+
+void PhysicsWorld::CastRays(const RayCast *rays, uint32_t count, RayHit *hits) const {
+    const uint32_t packets = (count + 3) / 4;
+    ParallelFor(packets, RAY_PACKET_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t p = begin; p < end; ++p) CastPacket(rays + p * 4, std::min(4u, count - p * 4), hits + p * 4);
+    });
+}
+
+void PhysicsWorld::QueryOverlaps(const Aabb *boxes, uint32_t count, BodyId *results, uint32_t maxResults,
+                                 uint32_t *counts) const {
+    ParallelFor(count, OVERLAP_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t q = begin; q < end; ++q) {
+            const Aabb &box = boxes[q];
+            BodyId *out = results + static_cast<size_t>(q) * maxResults;
+            uint32_t found = 0;
+            auto add = [&](BodyId id) {
+                if (found < maxResults) out[found] = id;
+                found++;
+            };
+            auto visit = [&](uint32_t id) {
+                if (bounds[denseOf[id]].Overlaps(box)) add(id);
+                return true;
+            };
+            dynamicTree.Query(box, visit);
+            staticTree.Query(box, visit);
+            ForEachPlane([&](uint32_t plane) {
+                Vec3 n = Rotate(Orientation(plane), PLANE_UP);
+                if (Dot(n, box.Center() - Position(plane)) <= Dot(Abs(n), (box.max - box.min) * Real(0.5f)))
+                    add(ids[plane]);
+            });
+            counts[q] = found;
+        }
+    });
+}
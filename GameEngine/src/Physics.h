@@ -0,0 +1,272 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include "AabbTree.h"
+#include "Memory.h"
+#include "PhysicsMath.h"
+
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+enum class ShapeType : uint8_t { Sphere, Box, Plane };
+
+typedef uint32_t BodyId;
+static const BodyId INVALID_BODY = 0xffffffffu;
+
+// Everything needed to create a body. mass 0 makes it static; planes are always static.
+struct BodyDesc {
+    ShapeType shape = ShapeType::Sphere;
+    Vec3 position;    // Planes: any point on the plane
+    Quat orientation; // Planes: ignored, see normal
+    Vec3 velocity, angularVelocity;
+    Real radius = 0.5f;                        // Sphere
+    Vec3 halfExtents = Vec3(0.5f, 0.5f, 0.5f); // Box
+    Vec3 normal = Vec3(0, 1, 0);               // Plane, pointing out of the solid side
+    Real mass = 1.0f;
+    Real friction = 0.5f;
+    Real restitution = 0.0f;
+};
+
+struct PhysicsConfig {
+    Vec3 gravity = Vec3(0, -9.81f, 0);
+    int velocityIterations = 10;
+    Real baumgarte = 0.2f; // Fraction of penetration removed per step
+    Real allowedPenetration = 0.005f;
+    Real restitutionThreshold = 1.0f; // Closing speeds below this do not bounce
+    Real linearDamping = 0.01f;       // Per second
+    Real angularDamping = 0.05f;
+    Real aabbMargin = 0.1f;     // Broad-phase boxes are this much larger than the body...
+    Real aabbPrediction = 2.0f; // ...and stretched this many steps along its velocity
+
+    // An island whose bodies all stayed below both speeds for timeToSleep seconds is put to sleep
+    bool allowSleep = true;
+    Real sleepLinearVelocity = 0.05f;
+    Real sleepAngularVelocity = 0.1f; // Radians per second
+    Real timeToSleep = 0.5f;
+
+    // A body about to move further in one step than this fraction of its smallest half extent gets
+    // a swept broad-phase box and speculative contacts, so it cannot tunnel. 0 turns that off.
+    Real ccdMotionThreshold = 0.5f;
+};
+
+// What the last Step did, for stats and benchmarks
+struct PhysicsStepStats {
+    uint32_t bodies = 0;
+    uint32_t pairs = 0;      // Broad-phase overlaps
+    uint32_t contacts = 0;   // Contact points after narrow phase
+    uint32_t reinserted = 0; // Bodies that left their fattened broad-phase box
+    uint32_t awake = 0;      // Dynamic bodies not sleeping
+    uint32_t islands = 0;    // Awake islands solved
+    uint32_t colors = 0;     // Most graph colors any island needed, 0 if none was large enough to split
+    uint32_t fast = 0;       // Bodies moving fast enough for continuous collision
+    uint32_t iterations = 0;
+    double broadPhaseTime = 0.0, narrowPhaseTime = 0.0, solverTime = 0.0, integrateTime = 0.0; // Seconds
+};
+
+// A ray, or with radius > 0 a swept sphere, for PhysicsWorld::CastRays
+struct RayCast {
+    Vec3 origin;
+    Vec3 direction; // Need not be unit length; distances are measured in world units
+    Real maxDistance = 1000.0f;
+    Real radius = 0.0f;
+    BodyId ignore = INVALID_BODY; // Such as the body the ray starts from
+    bool anyHit = false;          // Stop at the first hit found instead of the closest, for line of sight
+};
+
+struct RayHit {
+    BodyId body = INVALID_BODY; // INVALID_BODY when nothing was hit
+    Real distance = 0.0f;       // Along the ray to where the sphere (or ray) first touches the body
+    Vec3 point, normal;         // On the body's surface, normal pointing back at the ray
+};
+
+// One contact point between bodies a and b (dense indices). normal points from a to b,
+// depth > 0 means penetration. A speculative contact of a fast body has depth < 0, the gap left.
+struct Contact {
+    uint32_t a, b;
+    uint64_t key;     // Body pair (low id << 32 | high id), contacts are sorted by it
+    uint32_t feature; // Identifies the point within the pair across steps, for warm starting
+    Vec3 point, normal;
+    Real depth;
+    Real friction, restitution;
+
+    // Solver data
+    Vec3 rA, rB, tangent1, tangent2;
+    Real normalMass, tangentMass1, tangentMass2, bias;
+    Real normalImpulse, tangentImpulse1, tangentImpulse2; // Accumulated, carried to the next step
+};
+
+// Rigid body world for spheres, boxes and planes.
+//
+// Body state lives in structure-of-arrays columns indexed by a dense index, so integration and
+// bounds updates stream through memory and vectorize. BodyIds stay stable across removals through
+// an indirection table. Contacts are solved with sequential impulses (accumulated impulses with
+// clamping, Baumgarte position correction) warm-started from the previous step's impulses.
+//
+// Bodies connected through contacts form islands, which are solved in parallel; an island large
+// enough to matter is graph-colored so its contacts can be spread over jobs too. Islands at rest
+// fall asleep and cost nothing until something awake touches them.
+//
+// The order of pairs, contacts, islands and solver passes depends only on body ids, never on the
+// number of threads. Built with PHYSICS_FIXED_POINT, Real is 40.24 fixed point, and the same
+// inputs give bit-identical results on every machine and compiler, for lockstep games.
+class PhysicsWorld {
+  public:
+    template <typename T> using Array = TaggedVector<T, MemTag::Physics>; // All storage is charged to Physics
+
+    explicit PhysicsWorld(const PhysicsConfig &config = PhysicsConfig());
+
+    // Optional; without it everything runs on the calling thread
+    void SetJobSystem(JobSystem *jobs) { this->jobs = jobs; }
+
+    BodyId AddBody(const BodyDesc &desc);
+    void RemoveBody(BodyId id);
+    void Clear();
+    void Reserve(size_t bodyCount);
+
+    void Step(Real dt);
+
+    size_t BodyCount() const { return ids.size(); }
+    size_t DynamicBodyCount() const { return dynamicCount; }
+    size_t AwakeBodyCount() const { return awakeCount; }
+    bool IsValid(BodyId id) const { return id < denseOf.size() && denseOf[id] != INVALID_BODY; }
+
+    Vec3 GetPosition(BodyId id) const;
+    Quat GetOrientation(BodyId id) const;
+    Vec3 GetVelocity(BodyId id) const;
+    Vec3 GetAngularVelocity(BodyId id) const;
+    ShapeType GetShape(BodyId id) const { return shape[denseOf[id]]; }
+    bool IsAwake(BodyId id) const { return active[denseOf[id]] > Real(0); }
+    void WakeBody(BodyId id) { Wake(denseOf[id]); } // And the rest of its sleeping island
+    void SetVelocity(BodyId id, const Vec3 &velocity);
+    void ApplyImpulse(BodyId id, const Vec3 &impulse, const Vec3 &point);
+
+    // Batched scene queries, spread over the job system when one is set. Results go into the
+    // caller's arrays, one slot per query, without allocating. Must not overlap Step.
+    //
+    // CastRays traces consecutive rays four at a time through the trees, so keep rays that point
+    // the same way next to each other. A ray starting inside a body does not hit it.
+    void CastRays(const RayCast *rays, uint32_t count, RayHit *hits) const;
+    // Bodies whose bounding box overlaps each box. Query q writes up to maxResults ids at
+    // results + q * maxResults and the total it found, which may be larger, to counts[q].
+    void QueryOverlaps(const Aabb *boxes, uint32_t count, BodyId *results, uint32_t maxResults,
+                       uint32_t *counts) const;
+
+    const Array<Contact> &GetContacts() const { return contacts; }
+    const PhysicsStepStats &GetStats() const { return stats; }
+    PhysicsConfig &GetConfig() { return config; }
+
+  private:
+    // Velocity-level view of a body for the solver, packed for random access
+    struct SolverBody {
+        Vec3 v, w;
+        Mat3 invInertia; // World space
+        Real invMass;
+    };
+
+    // Contacts and bodies of one island, ranges into islandContacts and islandBodies
+    struct Island {
+        uint32_t contactBegin, contactCount;
+        uint32_t bodyBegin, bodyCount;
+    };
+
+    template <typename F> void ForEachColumn(F &&f);
+    template <typename F> void ParallelFor(uint32_t count, uint32_t grain, const F &fn) const; // On jobs when set
+    template <typename F> void ForEachPlane(F &&f) const;
+
+    void IntegrateVelocities(Real dt);
+    void FindFastBodies(Real dt);
+    void RebuildPlanes();
+    void UpdateBounds();
+    void UpdateTrees(Real dt);
+    void BroadPhase();
+    void FindPairs();
+    void FindSweptPairs(); // Fast bodies against everything along their path
+    bool WakeTouched();    // Wake sleeping bodies paired with a moving one, true if there were any
+    bool WakeContacted();  // Wake sleeping bodies with contacts, true if there were any
+    void Wake(uint32_t i);
+    void NarrowPhase();
+    void BuildIslands();
+    void SolveContacts(Real dt);
+    void SolveIsland(const Island &island, Real inverseDt);
+    void SolveColored(const Island &island, Real inverseDt);
+    void PrepareContact(Contact &c, Real inverseDt);
+    void WarmStartContact(Contact &c);
+    void SolveContact(Contact &c);
+    void UpdateSleep(Real dt);
+    void IntegratePositions(Real dt);
+    void CastPacket(const RayCast *rays, uint32_t count, RayHit *hits) const; // Up to four rays
+    bool CastShape(uint32_t i, const Vec3 &origin, const Vec3 &direction, Real radius, Real maxDistance,
+                   RayHit &hit) const;
+
+    Aabb Bounds(uint32_t i) const;
+    Aabb FatBounds(uint32_t i, Real dt) const;
+    // Contacts for one pair, including points up to margin apart (speculative, depth < 0)
+    void CollideSphereSphere(uint32_t a, uint32_t b, uint64_t key, Real margin);
+    void CollideSphereBox(uint32_t a, uint32_t b, uint64_t key, Real margin);
+    void CollideSpherePlane(uint32_t a, uint32_t b, uint64_t key, Real margin);
+    void CollideBoxBox(uint32_t a, uint32_t b, uint64_t key, Real margin);
+    void CollideBoxPlane(uint32_t a, uint32_t b, uint64_t key, Real margin);
+    void AddContact(uint32_t a, uint32_t b, uint64_t key, uint32_t feature, const Vec3 &point, const Vec3 &normal,
+                    Real depth);
+    Vec3 Position(uint32_t i) const { return Vec3(px[i], py[i], pz[i]); }
+    Quat Orientation(uint32_t i) const { return Quat(qx[i], qy[i], qz[i], qw[i]); }
+
+    PhysicsConfig config;
+    JobSystem *jobs = nullptr;
+
+    // ---- Body columns, all indexed by dense index ----
+    Array<Real> px, py, pz;      // Position
+    Array<Real> vx, vy, vz;      // Linear velocity
+    Array<Real> wx, wy, wz;      // Angular velocity
+    Array<Real> qx, qy, qz, qw;  // Orientation
+    Array<Real> invMass;         // 0 for static bodies
+    Array<Real> active;          // 1 for awake dynamic bodies, 0 for sleeping or static; masks integration
+    Array<Real> sleepTime;       // Seconds spent below the sleep velocities
+    Array<BodyId> sleepNext;     // Sleeping bodies: ring through the island they fell asleep with
+    Array<Vec3> invInertiaLocal; // Diagonal of the body-space inverse inertia
+    Array<Vec3> size;            // Box half extents, or sphere radius in x
+    Array<ShapeType> shape;
+    Array<Real> friction, restitution;
+    Array<Aabb> bounds;   // Tight, planes: unused
+    Array<int32_t> proxy; // Leaf in dynamicTree or staticTree by invMass, planes: none
+    Array<BodyId> ids;    // Dense index to id
+
+    Array<uint32_t> denseOf; // Id to dense index, INVALID_BODY when free
+    Array<BodyId> freeIds;
+    size_t dynamicCount = 0, awakeCount = 0;
+
+    // ---- Broad phase, tree leaves carry BodyIds ----
+    AabbTree dynamicTree, staticTree;
+    bool staticTreeDirty = false; // Static bodies changed; rebuild that tree top-down before the next query
+    Real rebuiltAreaRatio = 0.0f; // dynamicTree quality after its last rebuild
+    Array<uint32_t> planes;       // Dense indices of planes
+    bool planesDirty = false;     // Bodies were added or removed since planes was built
+
+    // ---- Per-step scratch, kept to avoid reallocating every step ----
+    Array<uint32_t> moved;              // Dense indices that left their fattened boxes
+    Array<Array<uint64_t>> pairBuffers; // One per pair-finding job
+    Array<uint64_t> pairs;              // Overlapping (low id << 32 | high id), sorted
+    Array<uint32_t> fastBodies;         // Dense indices due continuous collision this step
+    Array<Aabb> sweptBounds;            // Per fast body: its box over the whole step
+    Array<Real> speculativeMargin;      // Dense index to distance moved this step if fast, else 0
+    Array<Contact> contacts, previousContacts;
+    Array<SolverBody> solverBodies;
+
+    // Islands: union-find over dense indices, then contacts and bodies grouped per island
+    Array<uint32_t> islandParent, islandOf;
+    Array<uint32_t> islandContacts, islandBodies;
+    Array<Island> islands;
+    Array<uint32_t> smallIslands;
+
+    // Graph coloring of a large island, per manifold (the contacts of one body pair)
+    Array<uint64_t> colorMask;        // Dense index to colors already used at that body
+    Array<uint32_t> manifoldBegin;    // Into islandContacts, one past the end for the last
+    Array<uint8_t> manifoldColor;
+    Array<uint32_t> coloredManifolds; // Manifold indices grouped by color
+    Array<uint32_t> colorStart;       // Into coloredManifolds per color, plus the end
+    PhysicsStepStats stats;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef PHYSICS_MATH_H
+#define PHYSICS_MATH_H
+
+#include <cmath>
+
+// Scalar used by the physics module. Everything goes through Real and the helpers below
+// rather than calling <cmath> directly, so PHYSICS_FIXED_POINT can swap in deterministic
+// fixed-point math for lockstep games.
+#ifdef PHYSICS_FIXED_POINT
+#include "FixedPoint.h"
+typedef Fixed Real;
+static const Real REAL_HUGE = Fixed::FromRaw(int64_t(1) << 55); // Finite stand-in for infinity, about 2e9
+#else
+typedef float Real;
+static const Real REAL_HUGE = 1e30f;
+
+inline Real Sqrt(Real x) { return std::sqrt(x); }
+#endif
+inline Real Abs(Real x) { return x < Real(0) ? -x : x; }
+inline Real Min(Real a, Real b) { return a < b ? a : b; }
+inline Real Max(Real a, Real b) { return a > b ? a : b; }
+inline Real Clamp(Real x, Real low, Real high) { return Min(Max(x, low), high); }
+
+struct Vec3 {
+    Real x, y, z;
+
+    Vec3() : x(0), y(0), z(0) {}
+    Vec3(Real x, Real y, Real z) : x(x), y(y), z(z) {}
+
+    Real operator[](int i) const { return i == 0 ? x : (i == 1 ? y : z); }
+    Vec3 operator-() const { return Vec3(-x, -y, -z); }
+    Vec3 operator+(const Vec3 &o) const { return Vec3(x + o.x, y + o.y, z + o.z); }
+    Vec3 operator-(const Vec3 &o) const { return Vec3(x - o.x, y - o.y, z - o.z); }
+    Vec3 operator*(Real s) const { return Vec3(x * s, y * s, z * s); }
+    Vec3 &operator+=(const Vec3 &o) {
+        x += o.x;
+        y += o.y;
+        z += o.z;
+        return *this;
+    }
+    Vec3 &operator-=(const Vec3 &o) {
+        x -= o.x;
+        y -= o.y;
+        z -= o.z;
+        return *this;
+    }
+};
+
+inline Vec3 operator*(Real s, const Vec3 &v) { return v * s; }
+inline Real Dot(const Vec3 &a, const Vec3 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 Cross(const Vec3 &a, const Vec3 &b) {
+    return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline Real LengthSquared(const Vec3 &v) { return Dot(v, v); }
+inline Real Length(const Vec3 &v) { return Sqrt(Dot(v, v)); }
+inline Vec3 Normalize(const Vec3 &v) {
+    Real length = Length(v);
+    return length > Real(0) ? v * (Real(1) / length) : Vec3(0, 1, 0);
+}
+inline Vec3 Min(const Vec3 &a, const Vec3 &b) { return Vec3(Min(a.x, b.x), Min(a.y, b.y), Min(a.z, b.z)); }
+inline Vec3 Max(const Vec3 &a, const Vec3 &b) { return Vec3(Max(a.x, b.x), Max(a.y, b.y), Max(a.z, b.z)); }
+inline Vec3 Abs(const Vec3 &v) { return Vec3(Abs(v.x), Abs(v.y), Abs(v.z)); }
+
+// Two unit vectors perpendicular to n and to each other
+inline void Tangents(const Vec3 &n, Vec3 &t1, Vec3 &t2) {
+    if (Abs(n.x) >= Real(0.57735f))
+        t1 = Normalize(Vec3(n.y, -n.x, 0));
+    else
+        t1 = Normalize(Vec3(0, n.z, -n.y));
+    t2 = Cross(n, t1);
+}
+
+// 3x3 matrix stored as columns
+struct Mat3 {
+    Vec3 c0, c1, c2;
+
+    Mat3() {}
+    Mat3(const Vec3 &c0, const Vec3 &c1, const Vec3 &c2) : c0(c0), c1(c1), c2(c2) {}
+
+    const Vec3 &Column(int i) const { return i == 0 ? c0 : (i == 1 ? c1 : c2); }
+    Vec3 operator*(const Vec3 &v) const { return c0 * v.x + c1 * v.y + c2 * v.z; }
+    Vec3 TransposeTimes(const Vec3 &v) const { return Vec3(Dot(c0, v), Dot(c1, v), Dot(c2, v)); }
+};
+
+struct Quat {
+    Real x, y, z, w;
+
+    Quat() : x(0), y(0), z(0), w(1) {}
+    Quat(Real x, Real y, Real z, Real w) : x(x), y(y), z(z), w(w) {}
+};
+
+inline Quat operator*(const Quat &a, const Quat &b) {
+    return Quat(a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y, a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w, a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z);
+}
+
+inline Quat Normalize(const Quat &q) {
+    Real length = Sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    if (length <= Real(0)) return Quat();
+    Real inv = Real(1) / length;
+    return Quat(q.x * inv, q.y * inv, q.z * inv, q.w * inv);
+}
+
+inline Mat3 ToMatrix(const Quat &q) {
+    Real xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    Real xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    Real wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    return Mat3(Vec3(Real(1) - Real(2) * (yy + zz), Real(2) * (xy + wz), Real(2) * (xz - wy)),
+                Vec3(Real(2) * (xy - wz), Real(1) - Real(2) * (xx + zz), Real(2) * (yz + wx)),
+                Vec3(Real(2) * (xz + wy), Real(2) * (yz - wx), Real(1) - Real(2) * (xx + yy)));
+}
+
+inline Vec3 Rotate(const Quat &q, const Vec3 &v) {
+    Vec3 u(q.x, q.y, q.z);
+    Vec3 t = Cross(u, v) * Real(2);
+    return v + t * q.w + Cross(u, t);
+}
+
+// Shortest rotation taking unit vector from onto unit vector to
+inline Quat RotationBetween(const Vec3 &from, const Vec3 &to) {
+    Real d = Dot(from, to);
+    if (d < Real(-0.9999f)) {
+        Vec3 t1, t2;
+        Tangents(from, t1, t2);
+        return Quat(t1.x, t1.y, t1.z, 0);
+    }
+    Vec3 c = Cross(from, to);
+    return Normalize(Quat(c.x, c.y, c.z, Real(1) + d));
+}
+
+// First-order orientation update for angular velocity w over dt
+inline Quat Integrate(const Quat &q, const Vec3 &w, Real dt) {
+    Quat spin = Quat(w.x, w.y, w.z, 0) * q;
+    Real h = dt * Real(0.5f);
+    return Normalize(Quat(q.x + spin.x * h, q.y + spin.y * h, q.z + spin.z * h, q.w + spin.w * h));
+}
+
+struct Aabb {
+    Vec3 min, max;
+
+    bool Overlaps(const Aabb &o) const {
+        return min.x <= o.max.x && max.x >= o.min.x && min.y <= o.max.y && max.y >= o.min.y && min.z <= o.max.z &&
+               max.z >= o.min.z;
+    }
+    bool Contains(const Aabb &o) const {
+        return min.x <= o.min.x && min.y <= o.min.y && min.z <= o.min.z && max.x >= o.max.x && max.y >= o.max.y &&
+               max.z >= o.max.z;
+    }
+    Vec3 Center() const { return (min + max) * Real(0.5f); }
+    // Half the surface area, the usual cost metric for bounding volume trees
+    Real Area() const {
+        Vec3 d = max - min;
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+};
+
+inline Aabb Union(const Aabb &a, const Aabb &b) { return Aabb{Min(a.min, b.min), Max(a.max, b.max)}; }
+
+#endif
@@ -1,22 +1,45 @@
 #include "Renderer.h"
-#include <vector>
+#include "Log.h"
 
-Renderer::Renderer() : axisVAO(0), axisVBO(0), gridVAO(0), gridVBO(0) {}
+Renderer::Renderer() : axisVAO(0), axisVBO(0), gridVAO(0), gridVBO(0), program(0) {}
 
 Renderer::~Renderer() {
     glDeleteVertexArrays(1, &axisVAO);
     glDeleteBuffers(1, &axisVBO);
     glDeleteVertexArrays(1, &gridVAO);
     glDeleteBuffers(1, &gridVBO);
+    if (program) glDeleteProgram(program);
 }
 
 void Renderer::Init() {
+    BuildMeshes();
+    Upload();
+}
+
+void Renderer::BuildMeshes() {
     SetupAxes();
     SetupGrid(20, 1.0f); // 20x20 grid
 }
 
+void Renderer::SetShaderSources(std::string vertex, std::string fragment) {
+    vertexSource = std::move(vertex);
+    fragmentSource = std::move(fragment);
+}
+
+void Renderer::Upload() {
+    axisVAO = UploadLines(axisVertices, axisVBO);
+    gridVAO = UploadLines(gridVertices, gridVBO);
+    if (!vertexSource.empty() && !fragmentSource.empty()) CompileProgram();
+
+    // The GPU has its copy now
+    TaggedVector<float, MemTag::Render>().swap(axisVertices);
+    TaggedVector<float, MemTag::Render>().swap(gridVertices);
+    std::string().swap(vertexSource);
+    std::string().swap(fragmentSource);
+}
+
 void Renderer::SetupAxes() {
-    float axisVertices[] = {
+    axisVertices = {
         // X axis - red
         0.0f,
         0.0f,
@@ -57,24 +80,12 @@ void Renderer::SetupAxes() {
         0.0f,
         1.0f,
     };
-
-    glGenVertexArrays(1, &axisVAO);
-    glGenBuffers(1, &axisVBO);
-
-    glBindVertexArray(axisVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, axisVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(axisVertices), axisVertices, GL_STATIC_DRAW);
-
-    // Position
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-    // Color
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
 }
 
 void Renderer::SetupGrid(int count, float spacing) {
-    std::vector<float> vertices;
+    TaggedVector<float, MemTag::Render> &vertices = gridVertices;
+    vertices.clear();
+    vertices.reserve((count + 1) * 4 * 6);
     float half = (count * spacing) / 2.0f;
 
     for (int i = 0; i <= count; ++i) {
@@ -88,12 +99,16 @@ void Renderer::SetupGrid(int count, float spacing) {
         vertices.insert(vertices.end(), {-half, 0.0f, offset, 0.5f, 0.5f, 0.5f});
         vertices.insert(vertices.end(), {half, 0.0f, offset, 0.5f, 0.5f, 0.5f});
     }
+}
 
-    glGenVertexArrays(1, &gridVAO);
-    glGenBuffers(1, &gridVBO);
+// Interleaved position + color line vertices into a new VAO
+GLuint Renderer::UploadLines(const TaggedVector<float, MemTag::Render> &vertices, GLuint &vbo) {
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
 
-    glBindVertexArray(gridVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
 
     // Position
@@ -102,14 +117,60 @@ void Renderer::SetupGrid(int count, float spacing) {
     // Color
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
+    return vao;
+}
+
+static GLuint CompileShader(GLenum type, const std::string &source) {
+    GLuint shader = glCreateShader(type);
+    const char *text = source.c_str();
+    glShaderSource(shader, 1, &text, nullptr);
+    glCompileShader(shader);
+
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char info[512];
+        glGetShaderInfoLog(shader, sizeof(info), nullptr, info);
+        LOG_ERROR("{} shader: {}", type == GL_VERTEX_SHADER ? "Vertex" : "Fragment", info);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+void Renderer::CompileProgram() {
+    GLuint vertex = CompileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fragment = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    if (vertex && fragment) {
+        program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        glBindAttribLocation(program, 0, "position");
+        glBindAttribLocation(program, 1, "color");
+        glLinkProgram(program);
+
+        GLint ok = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &ok);
+        if (!ok) {
+            char info[512];
+            glGetProgramInfoLog(program, sizeof(info), nullptr, info);
+            LOG_ERROR("Shader link: {}", info);
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    if (vertex) glDeleteShader(vertex);
+    if (fragment) glDeleteShader(fragment);
 }
 
 void Renderer::RenderAxes() {
+    glUseProgram(program);
     glBindVertexArray(axisVAO);
     glDrawArrays(GL_LINES, 0, 6);
 }
 
 void Renderer::RenderGrid(int count, float spacing) {
+    glUseProgram(program);
     glBindVertexArray(gridVAO);
     glDrawArrays(GL_LINES, 0, count * 4 + 4);
 }
@@ -1,24 +1,42 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
+#include "Memory.h"
+
 #include <GL/glew.h>
 #include <glm/glm.hpp>
+#include <string>
 
 class Renderer {
   public:
     Renderer();
     ~Renderer();
 
-    void Init();
+    void Init(); // BuildMeshes + Upload
+
+    // CPU-side preparation, no GL calls: safe on a worker thread before the context exists
+    void BuildMeshes();
+    void SetShaderSources(std::string vertex, std::string fragment);
+
+    // Create GL objects from the prepared data. Main thread, context current.
+    void Upload();
+
     void RenderAxes();
     void RenderGrid(int count = 20, float spacing = 1.0f);
 
   private:
     GLuint axisVAO, axisVBO;
     GLuint gridVAO, gridVBO;
+    GLuint program; // 0 when no shader sources were given
+
+    // Filled by BuildMeshes/SetShaderSources, released by Upload
+    TaggedVector<float, MemTag::Render> axisVertices, gridVertices;
+    std::string vertexSource, fragmentSource;
 
     void SetupAxes();
     void SetupGrid(int count, float spacing);
+    GLuint UploadLines(const TaggedVector<float, MemTag::Render> &vertices, GLuint &vbo);
+    void CompileProgram();
 };
 
 #endif
@@ -0,0 +1,21 @@
+#ifndef SCENE_STATE_H
+#define SCENE_STATE_H
+
+#include <cstdint>
+
+// Everything the renderer needs from one simulation tick.
+// Plain data, copied into a snapshot, never shared between threads by reference.
+struct SceneState {
+    uint64_t tick = 0;      // Ticks simulated so far
+    double simTime = 0.0;   // Simulated seconds
+    bool animating = false; // Something is moving; on-demand rendering keeps drawing while set
+};
+
+// What the simulation hands to the renderer: the two latest ticks to interpolate between
+struct FrameSnapshot {
+    SceneState previous;
+    SceneState current;
+    double tickTime = 0.0; // Engine clock time (Now(), steady_clock seconds) that current corresponds to
+};
+
+#endif
@@ -0,0 +1,466 @@
+#include "SoftBody.h"
+#include "JobSystem.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Fixed-point builds stay scalar: the SSE paths are float only
+#if defined(__SSE2__) && !defined(PHYSICS_FIXED_POINT)
+#include <emmintrin.h>
+#define PHYSICS_SSE 1
+#endif
+
+static double Seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const uint32_t COLOR_SLOTS = 64;        // Constraints that find no free color of the first 63 go in the last
+static const uint32_t CONSTRAINT_GRAIN = 1024; // Constraints per job within one color
+static const uint32_t PARTICLE_GRAIN = 4096;   // Particles per job for per-particle passes
+static const Real MIN_LENGTH = 1e-6f;          // Shorter distance constraints have no direction and are skipped
+
+SoftBodyWorld::SoftBodyWorld(const SoftBodyConfig &config) : config(config) {}
+
+template <typename F> void SoftBodyWorld::ParallelFor(uint32_t count, uint32_t grain, const F &fn) const {
+    if (jobs) {
+        jobs->ParallelFor(count, grain, fn);
+        return;
+    }
+    for (uint32_t begin = 0; begin < count; begin += grain) fn(begin, std::min(begin + grain, count));
+}
+
+// ---- Bodies ----
+
+uint32_t SoftBodyWorld::AddParticles(const Vec3 *positions, uint32_t count, Real mass) {
+    uint32_t first = static_cast<uint32_t>(invMass.size());
+    Real inverse = mass > Real(0) ? Real(static_cast<int>(count)) / mass : Real(0);
+    for (uint32_t i = 0; i < count; ++i) {
+        px.push_back(positions[i].x), py.push_back(positions[i].y), pz.push_back(positions[i].z);
+        prevX.push_back(positions[i].x), prevY.push_back(positions[i].y), prevZ.push_back(positions[i].z);
+        vx.push_back(Real(0)), vy.push_back(Real(0)), vz.push_back(Real(0));
+        invMass.push_back(inverse);
+    }
+    return first;
+}
+
+void SoftBodyWorld::AddDistance(uint32_t a, uint32_t b, Real compliance) {
+    distanceA.push_back(a);
+    distanceB.push_back(b);
+    restLength.push_back(Length(GetPosition(a) - GetPosition(b)));
+    distanceCompliance.push_back(compliance);
+    colored = false;
+}
+
+static Real TetVolume(const Vec3 &a, const Vec3 &b, const Vec3 &c, const Vec3 &d) {
+    return Dot(Cross(b - a, c - a), d - a) / Real(6);
+}
+
+void SoftBodyWorld::AddVolume(const uint32_t *tet, Real compliance) {
+    tetA.push_back(tet[0]), tetB.push_back(tet[1]), tetC.push_back(tet[2]), tetD.push_back(tet[3]);
+    restVolume.push_back(TetVolume(GetPosition(tet[0]), GetPosition(tet[1]), GetPosition(tet[2]), GetPosition(tet[3])));
+    volumeCompliance.push_back(compliance);
+    colored = false;
+}
+
+uint32_t SoftBodyWorld::AddCloth(const ClothDesc &desc) {
+    if (desc.columns < 2 || desc.rows < 2) {
+        LOG_ERROR("Cloth needs at least 2x2 particles, got {}x{}", desc.columns, desc.rows);
+        return static_cast<uint32_t>(invMass.size());
+    }
+    const uint32_t columns = desc.columns, rows = desc.rows;
+    TaggedVector<Vec3, MemTag::Physics> positions(columns * rows);
+    auto fraction = [](uint32_t i, uint32_t n) { return Real(static_cast<int>(i)) / Real(static_cast<int>(n - 1)); };
+    for (uint32_t r = 0; r < rows; ++r)
+        for (uint32_t c = 0; c < columns; ++c)
+            positions[r * columns + c] =
+                desc.origin + desc.across * fraction(c, columns) + desc.down * fraction(r, rows);
+    uint32_t first = AddParticles(positions.data(), columns * rows, desc.mass);
+    if (desc.pinCorners) invMass[first] = invMass[first + columns - 1] = Real(0);
+
+    auto at = [&](uint32_t r, uint32_t c) { return first + r * columns + c; };
+    for (uint32_t r = 0; r < rows; ++r) {
+        for (uint32_t c = 0; c < columns; ++c) {
+            if (c + 1 < columns) AddDistance(at(r, c), at(r, c + 1), desc.stretchCompliance);
+            if (r + 1 < rows) AddDistance(at(r, c), at(r + 1, c), desc.stretchCompliance);
+            if (c + 1 < columns && r + 1 < rows) {
+                AddDistance(at(r, c), at(r + 1, c + 1), desc.shearCompliance);
+                AddDistance(at(r, c + 1), at(r + 1, c), desc.shearCompliance);
+            }
+            // Bending as distance across two edges: cheap, and enough for cloth that is not crumpled
+            if (c + 2 < columns) AddDistance(at(r, c), at(r, c + 2), desc.bendCompliance);
+            if (r + 2 < rows) AddDistance(at(r, c), at(r + 2, c), desc.bendCompliance);
+        }
+    }
+    return first;
+}
+
+uint32_t SoftBodyWorld::AddSoftBox(const SoftBoxDesc &desc) {
+    if (desc.cellsX < 1 || desc.cellsY < 1 || desc.cellsZ < 1) {
+        LOG_ERROR("Soft box needs at least one cell per axis");
+        return static_cast<uint32_t>(invMass.size());
+    }
+    const uint32_t nx = desc.cellsX + 1, ny = desc.cellsY + 1, nz = desc.cellsZ + 1;
+    TaggedVector<Vec3, MemTag::Physics> positions(nx * ny * nz);
+    Vec3 cell(desc.halfExtents.x * Real(2) / Real(static_cast<int>(desc.cellsX)),
+              desc.halfExtents.y * Real(2) / Real(static_cast<int>(desc.cellsY)),
+              desc.halfExtents.z * Real(2) / Real(static_cast<int>(desc.cellsZ)));
+    for (uint32_t z = 0; z < nz; ++z)
+        for (uint32_t y = 0; y < ny; ++y)
+            for (uint32_t x = 0; x < nx; ++x)
+                positions[(z * ny + y) * nx + x] =
+                    desc.center - desc.halfExtents +
+                    Vec3(cell.x * Real(static_cast<int>(x)), cell.y * Real(static_cast<int>(y)),
+                         cell.z * Real(static_cast<int>(z)));
+    uint32_t first = AddParticles(positions.data(), nx * ny * nz, desc.mass);
+
+    // Five tetrahedra per cell: four corners and the one between them. Neighbouring cells mirror the
+    // split so their shared faces are cut along the same diagonal.
+    static const int EVEN[5][4] = {{0, 1, 2, 4}, {3, 2, 1, 7}, {5, 4, 7, 1}, {6, 7, 4, 2}, {1, 2, 4, 7}};
+    static const int ODD[5][4] = {{1, 0, 5, 3}, {2, 3, 6, 0}, {4, 5, 0, 6}, {7, 6, 3, 5}, {0, 3, 5, 6}};
+    TaggedVector<uint64_t, MemTag::Physics> edges;
+    for (uint32_t z = 0; z < desc.cellsZ; ++z) {
+        for (uint32_t y = 0; y < desc.cellsY; ++y) {
+            for (uint32_t x = 0; x < desc.cellsX; ++x) {
+                uint32_t corners[8];
+                for (int i = 0; i < 8; ++i)
+                    corners[i] = first + ((z + (i >> 2)) * ny + y + ((i >> 1) & 1)) * nx + x + (i & 1);
+                const int(*tets)[4] = (x + y + z) % 2 ? ODD : EVEN;
+                for (int t = 0; t < 5; ++t) {
+                    uint32_t tet[4] = {corners[tets[t][0]], corners[tets[t][1]], corners[tets[t][2]],
+                                       corners[tets[t][3]]};
+                    AddVolume(tet, desc.volumeCompliance);
+                    for (int i = 0; i < 4; ++i) {
+                        for (int j = i + 1; j < 4; ++j) {
+                            uint32_t a = std::min(tet[i], tet[j]), b = std::max(tet[i], tet[j]);
+                            edges.push_back((static_cast<uint64_t>(a) << 32) | b);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    // Cells share edges; keep each once
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    for (uint64_t edge : edges)
+        AddDistance(static_cast<uint32_t>(edge >> 32), static_cast<uint32_t>(edge), desc.edgeCompliance);
+    return first;
+}
+
+void SoftBodyWorld::AddPlaneCollider(const Vec3 &normal, Real offset) {
+    Collider collider;
+    collider.shape = ShapeType::Plane;
+    collider.center = Normalize(normal);
+    collider.halfExtents = Vec3(offset, Real(0), Real(0));
+    colliders.push_back(collider);
+}
+
+void SoftBodyWorld::AddSphereCollider(const Vec3 &center, Real radius) {
+    Collider collider;
+    collider.shape = ShapeType::Sphere;
+    collider.center = center;
+    collider.halfExtents = Vec3(radius, Real(0), Real(0));
+    colliders.push_back(collider);
+}
+
+void SoftBodyWorld::AddBoxCollider(const Vec3 &center, const Vec3 &halfExtents, const Quat &orientation) {
+    Collider collider;
+    collider.shape = ShapeType::Box;
+    collider.center = center;
+    collider.halfExtents = halfExtents;
+    collider.rotation = ToMatrix(Normalize(orientation));
+    colliders.push_back(collider);
+}
+
+void SoftBodyWorld::Clear() {
+    for (auto *column : {&px, &py, &pz, &prevX, &prevY, &prevZ, &vx, &vy, &vz, &invMass, &restLength,
+                         &distanceCompliance, &restVolume, &volumeCompliance})
+        column->clear();
+    for (auto *column : {&distanceA, &distanceB, &distanceColors, &tetA, &tetB, &tetC, &tetD, &volumeColors})
+        column->clear();
+    colliders.clear();
+    colored = true;
+    stats = SoftBodyStats();
+}
+
+// ---- Coloring ----
+
+// Greedy coloring: each constraint takes the lowest color none of its particles has yet, then the
+// constraint columns are reordered by color with a counting sort. starts gets COLOR_SLOTS + 1 offsets.
+template <int N>
+static void ColorBatches(uint32_t count, const uint32_t *const (&particles)[N],
+                         TaggedVector<uint64_t, MemTag::Physics> &mask, TaggedVector<uint32_t, MemTag::Physics> &colors,
+                         TaggedVector<uint32_t, MemTag::Physics> &starts) {
+    std::fill(mask.begin(), mask.end(), 0);
+    colors.resize(count);
+    starts.assign(COLOR_SLOTS + 1, 0);
+    for (uint32_t k = 0; k < count; ++k) {
+        uint64_t used = 0;
+        for (int i = 0; i < N; ++i) used |= mask[particles[i][k]];
+        uint32_t color = COLOR_SLOTS - 1;
+        for (uint32_t c = 0; c < COLOR_SLOTS - 1; ++c) {
+            if (!(used & (uint64_t(1) << c))) {
+                color = c;
+                break;
+            }
+        }
+        for (int i = 0; i < N; ++i) mask[particles[i][k]] |= uint64_t(1) << color;
+        colors[k] = color;
+        starts[color + 1]++;
+    }
+    for (uint32_t c = 0; c < COLOR_SLOTS; ++c) starts[c + 1] += starts[c];
+}
+
+// Move entry k of a column to slot order[k]
+template <typename T>
+static void Permute(TaggedVector<T, MemTag::Physics> &column, const TaggedVector<uint32_t, MemTag::Physics> &order) {
+    TaggedVector<T, MemTag::Physics> sorted(column.size());
+    for (size_t k = 0; k < column.size(); ++k) sorted[order[k]] = column[k];
+    column.swap(sorted);
+}
+
+void SoftBodyWorld::ColorConstraints() {
+    colorMask.resize(invMass.size());
+    TaggedVector<uint32_t, MemTag::Physics> colors, order;
+
+    auto place = [&](const TaggedVector<uint32_t, MemTag::Physics> &starts) {
+        TaggedVector<uint32_t, MemTag::Physics> next(starts.begin(), starts.end() - 1);
+        order.resize(colors.size());
+        for (size_t k = 0; k < colors.size(); ++k) order[k] = next[colors[k]]++;
+    };
+
+    const uint32_t *const distanceParticles[2] = {distanceA.data(), distanceB.data()};
+    ColorBatches<2>(static_cast<uint32_t>(distanceA.size()), distanceParticles, colorMask, colors, distanceColors);
+    place(distanceColors);
+    Permute(distanceA, order), Permute(distanceB, order), Permute(restLength, order);
+    Permute(distanceCompliance, order);
+
+    const uint32_t *const tetParticles[4] = {tetA.data(), tetB.data(), tetC.data(), tetD.data()};
+    ColorBatches<4>(static_cast<uint32_t>(tetA.size()), tetParticles, colorMask, colors, volumeColors);
+    place(volumeColors);
+    Permute(tetA, order), Permute(tetB, order), Permute(tetC, order), Permute(tetD, order);
+    Permute(restVolume, order), Permute(volumeCompliance, order);
+
+    stats.colors = 0;
+    for (uint32_t c = 0; c < COLOR_SLOTS; ++c) {
+        stats.colors += distanceColors[c + 1] > distanceColors[c];
+        stats.colors += volumeColors[c + 1] > volumeColors[c];
+    }
+    if (distanceColors[COLOR_SLOTS] > distanceColors[COLOR_SLOTS - 1] ||
+        volumeColors[COLOR_SLOTS] > volumeColors[COLOR_SLOTS - 1])
+        LOG_WARN("Soft body constraints ran out of colors, the rest are solved serially");
+    colored = true;
+}
+
+// ---- Step ----
+
+void SoftBodyWorld::Step(Real dt) {
+    if (!colored) ColorConstraints();
+    stats.particles = static_cast<uint32_t>(invMass.size());
+    stats.constraints = static_cast<uint32_t>(distanceA.size() + tetA.size());
+    stats.integrateTime = stats.solveTime = stats.collideTime = 0.0;
+    if (invMass.empty() || dt <= Real(0) || config.substeps < 1) return;
+
+    const uint32_t particles = static_cast<uint32_t>(invMass.size());
+    const Real h = dt / Real(config.substeps);
+    const Real inverseH2 = Real(1) / (h * h);
+    for (int substep = 0; substep < config.substeps; ++substep) {
+        double start = Seconds();
+        Integrate(h);
+        double integrated = Seconds();
+
+        // Colors one after another, each split across jobs; the overflow color last, on this thread
+        for (uint32_t c = 0; c < COLOR_SLOTS; ++c) {
+            uint32_t begin = distanceColors[c], count = distanceColors[c + 1] - begin;
+            if (count == 0) continue;
+            if (c == COLOR_SLOTS - 1) {
+                SolveDistances(begin, begin + count, inverseH2);
+                continue;
+            }
+            ParallelFor(count, CONSTRAINT_GRAIN, [&](uint32_t first, uint32_t last) {
+                SolveDistances(begin + first, begin + last, inverseH2);
+            });
+        }
+        for (uint32_t c = 0; c < COLOR_SLOTS; ++c) {
+            uint32_t begin = volumeColors[c], count = volumeColors[c + 1] - begin;
+            if (count == 0) continue;
+            if (c == COLOR_SLOTS - 1) {
+                SolveVolumes(begin, begin + count, inverseH2);
+                continue;
+            }
+            ParallelFor(count, CONSTRAINT_GRAIN / 4, [&](uint32_t first, uint32_t last) {
+                SolveVolumes(begin + first, begin + last, inverseH2);
+            });
+        }
+        double solved = Seconds();
+
+        if (!colliders.empty())
+            ParallelFor(particles, PARTICLE_GRAIN, [&](uint32_t begin, uint32_t end) { Collide(begin, end); });
+        double collided = Seconds();
+        UpdateVelocities(h);
+
+        stats.integrateTime += integrated - start + Seconds() - collided;
+        stats.solveTime += solved - integrated;
+        stats.collideTime += collided - solved;
+    }
+}
+
+// Apply gravity and damping to free particles and predict where they end up
+void SoftBodyWorld::Integrate(Real h) {
+    const Vec3 dv = config.gravity * h;
+    const Real keep = Max(Real(0), Real(1) - config.damping * h);
+    ParallelFor(static_cast<uint32_t>(invMass.size()), PARTICLE_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            prevX[i] = px[i], prevY[i] = py[i], prevZ[i] = pz[i];
+            if (invMass[i] == Real(0)) continue;
+            vx[i] = (vx[i] + dv.x) * keep, vy[i] = (vy[i] + dv.y) * keep, vz[i] = (vz[i] + dv.z) * keep;
+            px[i] += vx[i] * h, py[i] += vy[i] * h, pz[i] += vz[i] * h;
+        }
+    });
+}
+
+void SoftBodyWorld::UpdateVelocities(Real h) {
+    const Real inverseH = Real(1) / h;
+    ParallelFor(static_cast<uint32_t>(invMass.size()), PARTICLE_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            vx[i] = (px[i] - prevX[i]) * inverseH;
+            vy[i] = (py[i] - prevY[i]) * inverseH;
+            vz[i] = (pz[i] - prevZ[i]) * inverseH;
+        }
+    });
+}
+
+// XPBD distance projection. Within a color no two constraints share a particle, so each group of four
+// is gathered, projected in SSE lanes and scattered back without conflicts.
+void SoftBodyWorld::SolveDistances(uint32_t begin, uint32_t end, Real inverseH2) {
+    uint32_t k = begin;
+#ifdef PHYSICS_SSE
+    const __m128 alphaScale = _mm_set1_ps(inverseH2), minLength = _mm_set1_ps(MIN_LENGTH);
+    for (; k + 4 <= end; k += 4) {
+        const uint32_t *a = &distanceA[k], *b = &distanceB[k];
+        __m128 ax = _mm_setr_ps(px[a[0]], px[a[1]], px[a[2]], px[a[3]]);
+        __m128 ay = _mm_setr_ps(py[a[0]], py[a[1]], py[a[2]], py[a[3]]);
+        __m128 az = _mm_setr_ps(pz[a[0]], pz[a[1]], pz[a[2]], pz[a[3]]);
+        __m128 bx = _mm_setr_ps(px[b[0]], px[b[1]], px[b[2]], px[b[3]]);
+        __m128 by = _mm_setr_ps(py[b[0]], py[b[1]], py[b[2]], py[b[3]]);
+        __m128 bz = _mm_setr_ps(pz[b[0]], pz[b[1]], pz[b[2]], pz[b[3]]);
+        __m128 wa = _mm_setr_ps(invMass[a[0]], invMass[a[1]], invMass[a[2]], invMass[a[3]]);
+        __m128 wb = _mm_setr_ps(invMass[b[0]], invMass[b[1]], invMass[b[2]], invMass[b[3]]);
+
+        __m128 dx = _mm_sub_ps(ax, bx), dy = _mm_sub_ps(ay, by), dz = _mm_sub_ps(az, bz);
+        __m128 length = _mm_sqrt_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        __m128 c = _mm_sub_ps(length, _mm_loadu_ps(&restLength[k]));
+        __m128 denominator =
+            _mm_add_ps(_mm_add_ps(wa, wb), _mm_mul_ps(_mm_loadu_ps(&distanceCompliance[k]), alphaScale));
+        // Scaled by 1 / length so it applies to the unnormalized direction; lanes that cannot move are masked
+        __m128 valid = _mm_and_ps(_mm_cmpgt_ps(length, minLength), _mm_cmpgt_ps(denominator, _mm_setzero_ps()));
+        __m128 s = _mm_and_ps(valid, _mm_div_ps(c, _mm_mul_ps(denominator, length)));
+        __m128 sa = _mm_mul_ps(s, wa), sb = _mm_mul_ps(s, wb);
+
+        alignas(16) float out[6][4];
+        _mm_store_ps(out[0], _mm_sub_ps(ax, _mm_mul_ps(sa, dx)));
+        _mm_store_ps(out[1], _mm_sub_ps(ay, _mm_mul_ps(sa, dy)));
+        _mm_store_ps(out[2], _mm_sub_ps(az, _mm_mul_ps(sa, dz)));
+        _mm_store_ps(out[3], _mm_add_ps(bx, _mm_mul_ps(sb, dx)));
+        _mm_store_ps(out[4], _mm_add_ps(by, _mm_mul_ps(sb, dy)));
+        _mm_store_ps(out[5], _mm_add_ps(bz, _mm_mul_ps(sb, dz)));
+        for (int lane = 0; lane < 4; ++lane) {
+            px[a[lane]] = out[0][lane], py[a[lane]] = out[1][lane], pz[a[lane]] = out[2][lane];
+            px[b[lane]] = out[3][lane], py[b[lane]] = out[4][lane], pz[b[lane]] = out[5][lane];
+        }
+    }
+#endif
+    for (; k < end; ++k) {
+        uint32_t a = distanceA[k], b = distanceB[k];
+        Real wa = invMass[a], wb = invMass[b];
+        Real denominator = wa + wb + distanceCompliance[k] * inverseH2;
+        Vec3 d(px[a] - px[b], py[a] - py[b], pz[a] - pz[b]);
+        Real length = Length(d);
+        if (length <= MIN_LENGTH || denominator <= Real(0)) continue;
+        Vec3 step = d * ((length - restLength[k]) / (denominator * length));
+        px[a] -= step.x * wa, py[a] -= step.y * wa, pz[a] -= step.z * wa;
+        px[b] += step.x * wb, py[b] += step.y * wb, pz[b] += step.z * wb;
+    }
+}
+
+// XPBD volume projection, C = 6 (V - V0) with the gradients of the signed tetrahedron volume
+void SoftBodyWorld::SolveVolumes(uint32_t begin, uint32_t end, Real inverseH2) {
+    for (uint32_t k = begin; k < end; ++k) {
+        const uint32_t ids[4] = {tetA[k], tetB[k], tetC[k], tetD[k]};
+        Vec3 p[4];
+        for (int i = 0; i < 4; ++i) p[i] = GetPosition(ids[i]);
+        Vec3 grad[4] = {Cross(p[3] - p[1], p[2] - p[1]), Cross(p[2] - p[0], p[3] - p[0]),
+                        Cross(p[3] - p[0], p[1] - p[0]), Cross(p[1] - p[0], p[2] - p[0])};
+        Real denominator = volumeCompliance[k] * inverseH2;
+        for (int i = 0; i < 4; ++i) denominator += invMass[ids[i]] * LengthSquared(grad[i]);
+        if (denominator <= Real(0)) continue;
+        Real s = -(TetVolume(p[0], p[1], p[2], p[3]) - restVolume[k]) * Real(6) / denominator;
+        for (int i = 0; i < 4; ++i) {
+            Vec3 moved = p[i] + grad[i] * (s * invMass[ids[i]]);
+            px[ids[i]] = moved.x, py[ids[i]] = moved.y, pz[ids[i]] = moved.z;
+        }
+    }
+}
+
+// Push particles out of the colliders and take friction off the substep's sliding motion
+void SoftBodyWorld::Collide(uint32_t begin, uint32_t end) {
+    const Real thickness = config.thickness, friction = Clamp(config.friction, Real(0), Real(1));
+    for (uint32_t i = begin; i < end; ++i) {
+        if (invMass[i] == Real(0)) continue;
+        Vec3 p(px[i], py[i], pz[i]);
+        bool touched = false;
+        Vec3 normal;
+        for (const Collider &collider : colliders) {
+            Real depth = Real(0);
+            Vec3 n;
+            if (collider.shape == ShapeType::Plane) {
+                n = collider.center;
+                depth = collider.halfExtents.x + thickness - Dot(n, p);
+            } else if (collider.shape == ShapeType::Sphere) {
+                Vec3 d = p - collider.center;
+                Real distance = Length(d);
+                if (distance <= MIN_LENGTH) continue;
+                n = d * (Real(1) / distance);
+                depth = collider.halfExtents.x + thickness - distance;
+            } else {
+                // Inside the grown box: out through the nearest face
+                Vec3 local = collider.rotation.TransposeTimes(p - collider.center);
+                Vec3 gap = collider.halfExtents + Vec3(thickness, thickness, thickness) - Abs(local);
+                if (gap.x <= Real(0) || gap.y <= Real(0) || gap.z <= Real(0)) continue;
+                int axis = gap.x < gap.y ? (gap.x < gap.z ? 0 : 2) : (gap.y < gap.z ? 1 : 2);
+                Real side = (axis == 0 ? local.x : axis == 1 ? local.y : local.z) < Real(0) ? Real(-1) : Real(1);
+                n = collider.rotation.Column(axis) * side;
+                depth = axis == 0 ? gap.x : axis == 1 ? gap.y : gap.z;
+            }
+            if (depth <= Real(0)) continue;
+            p += n * depth;
+            normal = n;
+            touched = true;
+        }
+        if (!touched) continue;
+
+        Vec3 moved = p - Vec3(prevX[i], prevY[i], prevZ[i]);
+        Vec3 sliding = moved - normal * Dot(moved, normal);
+        p -= sliding * friction;
+        px[i] = p.x, py[i] = p.y, pz[i] = p.z;
+    }
+}
+
+// ---- Scenes ----
+
+void SpawnClothDrape(SoftBodyWorld &world, uint32_t resolution) {
+    world.AddPlaneCollider(Vec3(0, 1, 0), Real(0));
+    world.AddSphereCollider(Vec3(0, -1, 0), Real(3));
+    world.AddBoxCollider(Vec3(5, 0.5f, -5), Vec3(1.5f, 0.5f, 1),
+                         RotationBetween(Vec3(1, 0, 0), Normalize(Vec3(1, 0, 1))));
+
+    ClothDesc cloth;
+    cloth.origin = Vec3(-10, 4, -10);
+    cloth.across = Vec3(20, 0, 0);
+    cloth.down = Vec3(0, 0, 20);
+    cloth.columns = cloth.rows = resolution;
+    cloth.mass = 40.0f; // 0.1 kg per square meter
+    world.AddCloth(cloth);
+}
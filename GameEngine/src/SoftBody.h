@@ -0,0 +1,131 @@
+#ifndef SOFT_BODY_H
+#define SOFT_BODY_H
+
+#include "Memory.h"
+#include "Physics.h"
+
+#include <cstdint>
+
+class JobSystem;
+
+// A rectangular sheet of rows x columns particles spanning origin + s * across + t * down, s and t in [0, 1].
+// Compliance is inverse stiffness in meters per newton; 0 is rigid.
+struct ClothDesc {
+    Vec3 origin;
+    Vec3 across = Vec3(1, 0, 0), down = Vec3(0, 0, 1);
+    uint32_t columns = 16, rows = 16;
+    Real mass = 1.0f; // Whole sheet
+    Real stretchCompliance = 0.0f;
+    Real shearCompliance = 0.0001f;
+    Real bendCompliance = 0.01f;
+    bool pinCorners = false; // Hold the two corners along the first row in place
+};
+
+// A box of soft material: a lattice of cells split into five tetrahedra each, held by edge lengths
+// and tetrahedron volumes
+struct SoftBoxDesc {
+    Vec3 center, halfExtents = Vec3(0.5f, 0.5f, 0.5f);
+    uint32_t cellsX = 4, cellsY = 4, cellsZ = 4;
+    Real mass = 1.0f;
+    Real edgeCompliance = 0.0001f;
+    Real volumeCompliance = 0.0f;
+};
+
+struct SoftBodyConfig {
+    Vec3 gravity = Vec3(0, -9.81f, 0);
+    int substeps = 8;       // Each with one constraint pass: small steps converge better than many passes
+    Real damping = 0.1f;    // Of particle velocity, per second
+    Real friction = 0.5f;   // Against colliders, 1 sticks
+    Real thickness = 0.01f; // Particles keep this far from collider surfaces
+};
+
+struct SoftBodyStats {
+    uint32_t particles = 0;
+    uint32_t constraints = 0; // Distance and volume
+    uint32_t colors = 0;      // Constraint batches solved one after another per substep
+    double integrateTime = 0.0, solveTime = 0.0, collideTime = 0.0; // Seconds
+};
+
+// Extended position-based dynamics (XPBD) for cloth and soft volumes.
+//
+// Particles live in structure-of-arrays columns. Each step is split into substeps that predict
+// positions, project every constraint once, push particles out of colliders and derive velocities
+// from the motion. With one pass per substep the Lagrange multipliers start at zero each time, so
+// none are stored. Constraints are graph-colored once when bodies are added and stored grouped by
+// color; within a color no two share a particle, so a color is projected four at a time with SSE
+// and split across jobs.
+class SoftBodyWorld {
+  public:
+    template <typename T> using Array = TaggedVector<T, MemTag::Physics>;
+
+    explicit SoftBodyWorld(const SoftBodyConfig &config = SoftBodyConfig());
+
+    // Optional; without it everything runs on the calling thread
+    void SetJobSystem(JobSystem *jobs) { this->jobs = jobs; }
+
+    // Both return the body's first particle. Cloth particle (row, column) follows at row * columns + column,
+    // soft box particles at (z * (cellsY + 1) + y) * (cellsX + 1) + x.
+    uint32_t AddCloth(const ClothDesc &desc);
+    uint32_t AddSoftBox(const SoftBoxDesc &desc);
+
+    // Static shapes particles collide with
+    void AddPlaneCollider(const Vec3 &normal, Real offset); // Solid where Dot(normal, p) < offset
+    void AddSphereCollider(const Vec3 &center, Real radius);
+    void AddBoxCollider(const Vec3 &center, const Vec3 &halfExtents, const Quat &orientation = Quat());
+    void Clear();
+
+    void Step(Real dt);
+
+    size_t ParticleCount() const { return invMass.size(); }
+    Vec3 GetPosition(uint32_t particle) const { return Vec3(px[particle], py[particle], pz[particle]); }
+    Vec3 GetVelocity(uint32_t particle) const { return Vec3(vx[particle], vy[particle], vz[particle]); }
+    const SoftBodyStats &GetStats() const { return stats; }
+    SoftBodyConfig &GetConfig() { return config; }
+
+  private:
+    struct Collider {
+        ShapeType shape;
+        Vec3 center, halfExtents; // Planes: normal in center, offset in halfExtents.x; spheres: radius in x
+        Mat3 rotation;            // Boxes
+    };
+
+    template <typename F> void ParallelFor(uint32_t count, uint32_t grain, const F &fn) const;
+
+    uint32_t AddParticles(const Vec3 *positions, uint32_t count, Real mass);
+    void AddDistance(uint32_t a, uint32_t b, Real compliance);
+    void AddVolume(const uint32_t *tet, Real compliance);
+    void ColorConstraints();
+    void Integrate(Real h);
+    void SolveDistances(uint32_t begin, uint32_t end, Real inverseH2);
+    void SolveVolumes(uint32_t begin, uint32_t end, Real inverseH2);
+    void Collide(uint32_t begin, uint32_t end);
+    void UpdateVelocities(Real h);
+
+    SoftBodyConfig config;
+    JobSystem *jobs = nullptr;
+
+    // ---- Particles ----
+    Array<Real> px, py, pz;          // Position
+    Array<Real> prevX, prevY, prevZ; // At the start of the substep
+    Array<Real> vx, vy, vz;
+    Array<Real> invMass;             // 0 pins a particle
+
+    // ---- Constraints, grouped by color once colored ----
+    Array<uint32_t> distanceA, distanceB;
+    Array<Real> restLength, distanceCompliance;
+    Array<uint32_t> distanceColors; // Start of each color, plus the end; the last color is solved serially
+    Array<uint32_t> tetA, tetB, tetC, tetD;
+    Array<Real> restVolume, volumeCompliance;
+    Array<uint32_t> volumeColors;
+    Array<uint64_t> colorMask; // Coloring scratch, per particle
+    bool colored = true;
+
+    Array<Collider> colliders;
+    SoftBodyStats stats;
+};
+
+// The cloth benchmark: a resolution x resolution sheet as large as the renderer's 20 m grid,
+// dropped onto the grid plane over a dome and a low box
+void SpawnClothDrape(SoftBodyWorld &world, uint32_t resolution);
+
+#endif
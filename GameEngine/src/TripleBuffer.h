@@ -0,0 +1,39 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// Lock-free single-writer single-reader handoff of whole values.
+// The writer fills its private slot and publishes it by swapping with the shared middle slot;
+// the reader swaps the middle slot into its own private slot when a newer value is there.
+// Neither side ever waits, and the reader always sees the latest complete value.
+template <typename T> class TripleBuffer {
+  public:
+    // Writer side
+    T &WriteBuffer() { return slots[writeIndex].value; }
+    void Publish() { writeIndex = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK; }
+
+    // Reader side. Returns true if a newer value was swapped in.
+    bool Acquire() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+    const T &ReadBuffer() const { return slots[readIndex].value; }
+    bool HasFresh() const { return (middle.load(std::memory_order_relaxed) & FRESH) != 0; }
+
+  private:
+    static const unsigned INDEX_MASK = 3;
+    static const unsigned FRESH = 4;
+
+    struct alignas(64) Slot {
+        T value;
+    };
+
+    Slot slots[3];
+    unsigned writeIndex = 0;                     // Writer thread only
+    unsigned readIndex = 1;                      // Reader thread only
+    alignas(64) std::atomic<unsigned> middle{2}; // Index of the shared slot, plus the FRESH bit
+};
+
+#endif
@@ -1,7 +1,149 @@
 #include "Engine.h"
+#include "Log.h"
 
-int main() {
-    Engine engine;
-    engine.Run();
-    return 0;
+#include <cerrno>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// The whole of text as a finite number; false on trailing characters or overflow
+static bool ParseNumber(const char *text, double &value) {
+    char *end = nullptr;
+    errno = 0;
+    double parsed = strtod(text, &end);
+    if (end == text || *end != '\0' || errno == ERANGE || !std::isfinite(parsed)) return false;
+    value = parsed;
+    return true;
+}
+
+static bool ParseNumber(const char *text, float &value) {
+    double parsed;
+    if (!ParseNumber(text, parsed) || std::abs(parsed) > FLT_MAX) return false;
+    value = static_cast<float>(parsed);
+    return true;
+}
+
+// The whole of text as a decimal int; false on trailing characters or a value out of range
+static bool ParseNumber(const char *text, int &value) {
+    char *end = nullptr;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX) return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+static bool BadValue(const char *option, const char *value) {
+    LOG_ERROR("{} expects a number, got '{}'", option, value);
+    return false;
+}
+
+// Fill config from command-line flags, returns false on an unknown or malformed flag
+static bool ParseArgs(int argc, char **argv, EngineConfig &config) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(arg, "--tick-rate") == 0 && hasValue) {
+            if (!ParseNumber(argv[++i], config.tickRate)) return BadValue(arg, argv[i]);
+            if (config.tickRate <= 0.0) {
+                LOG_ERROR("--tick-rate must be positive");
+                return false;
+            }
+        } else if (strcmp(arg, "--max-catch-up") == 0 && hasValue) {
+            if (!ParseNumber(argv[++i], config.maxCatchUpTicks)) return BadValue(arg, argv[i]);
+            if (config.maxCatchUpTicks < 1) {
+                LOG_ERROR("--max-catch-up must be at least 1");
+                return false;
+            }
+        } else if (strcmp(arg, "--fps-cap") == 0 && hasValue) {
+            if (!ParseNumber(argv[++i], config.maxFrameRate)) return BadValue(arg, argv[i]);
+        } else if (strcmp(arg, "--no-vsync") == 0) {
+            config.vsync = false;
+        } else if (strcmp(arg, "--single-thread") == 0) {
+            config.pipelined = false;
+        } else if (strcmp(arg, "--workers") == 0 && hasValue) {
+            if (!ParseNumber(argv[++i], config.workerThreads)) return BadValue(arg, argv[i]);
+        } else if (strcmp(arg, "--stats-interval") == 0 && hasValue) {
+            if (!ParseNumber(argv[++i], config.statsInterval)) return BadValue(arg, argv[i]);
+        } else if (strcmp(arg, "--stats-csv") == 0 && hasValue) {
+            config.statsCsv = argv[++i];
+        } else if (strcmp(arg, "--display") == 0 && hasValue) {
+            config.display = argv[++i];
+        } else if (strcmp(arg, "--size") == 0 && hasValue) {
+            char extra;
+            if (sscanf(argv[++i], "%dx%d%c", &config.width, &config.height, &extra) != 2) {
+                LOG_ERROR("--size expects WIDTHxHEIGHT");
+                return false;
+            }
+        } else if (strcmp(arg, "--frames") == 0 && hasValue) {
+            if (!ParseNumber(argv[++i], config.maxFrames)) return BadValue(arg, argv[i]);
+        } else if (strcmp(arg, "--dump-frame") == 0 && hasValue) {
+            config.dumpFrame = argv[++i];
+        } else if (strcmp(arg, "--on-demand") == 0) {
+            config.onDemand = true;
+        } else if (strcmp(arg, "--dynamic-res") == 0 && hasValue) {
+            if (!ParseNumber(argv[++i], config.targetGpuTime)) return BadValue(arg, argv[i]);
+            config.targetGpuTime /= 1000.0;
+        } else if (strcmp(arg, "--min-scale") == 0 && hasValue) {
+            if (!ParseNumber(argv[++i], config.minRenderScale)) return BadValue(arg, argv[i]);
+        } else if (strcmp(arg, "--physics-demo") == 0 && hasValue) {
+            if (!ParseNumber(argv[++i], config.physicsDemo)) return BadValue(arg, argv[i]);
+        } else if (strcmp(arg, "--cloth-demo") == 0 && hasValue) {
+            if (!ParseNumber(argv[++i], config.clothDemo)) return BadValue(arg, argv[i]);
+        } else if (strcmp(arg, "--fluid-demo") == 0 && hasValue) {
+            if (!ParseNumber(argv[++i], config.fluidDemo)) return BadValue(arg, argv[i]);
+        } else if (strcmp(arg, "--shader-dir") == 0 && hasValue) {
+            config.shaderDir = argv[++i];
+        } else if (strcmp(arg, "--log-file") == 0 && hasValue) {
+            config.logFile = argv[++i];
+        } else if (strcmp(arg, "--log-level") == 0 && hasValue) {
+            LogLevel level;
+            if (!Log::ParseLevel(argv[++i], level)) {
+                LOG_ERROR("--log-level expects debug, info, warn or error");
+                return false;
+            }
+            Log::SetLevel(level);
+        } else {
+            LOG_ERROR("Unknown option: {}", arg);
+            return false;
+        }
+    }
+
+    if (config.maxFrameRate < 0.0) {
+        LOG_ERROR("--fps-cap must be non-negative");
+        return false;
+    }
+    if (config.width <= 0 || config.height <= 0 || config.maxFrames < 0 || config.physicsDemo < 0 ||
+        config.clothDemo < 0 || config.clothDemo == 1 || config.fluidDemo < 0) {
+        LOG_ERROR("Size must be positive, --frames, --physics-demo and --fluid-demo non-negative, --cloth-demo 0 or at "
+                  "least 2");
+        return false;
+    }
+    if (config.targetGpuTime < 0.0 || config.minRenderScale <= 0.0f || config.minRenderScale > 1.0f) {
+        LOG_ERROR("--dynamic-res must be non-negative and --min-scale in (0, 1]");
+        return false;
+    }
+    if (!config.dumpFrame.empty() && config.maxFrames == 0) {
+        LOG_ERROR("--dump-frame needs --frames to know which frame is the last");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    EngineConfig config;
+    if (!ParseArgs(argc, argv, config)) return 1;
+
+    Log::Start(config.logFile);
+    bool ok;
+    {
+        Engine engine(config);
+        ok = engine.Run();
+    }
+    Log::Stop();
+    return ok ? 0 : 1;
 }
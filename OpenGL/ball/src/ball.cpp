@@ -1,12 +1,38 @@
+#include "mixer.h"
+
+// Build with -DBALL_HEADLESS for the benchmark binary: no window, no GL, no rendering code at all
+#ifndef BALL_HEADLESS
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#endif
+#include <cctype>
+#include <cerrno>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <ctime>
+#include <cstring>
 #include <iostream>
+#include <new>
 #include <vector>
 
-#define MAX_BALLS 3000
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Default ball cap, override with --max-balls N or the BALL_MAX_BALLS environment variable
+const size_t DEFAULT_MAX_BALLS = 3000;
+
+// Simulation never runs more than this many ticks per rendered frame (avoids the spiral of death)
+const int MAX_TICKS_PER_FRAME = 8;
+
+// When balls can come to rest (gravity on or restitution below 1), wall hits slower than this
+// (units/s) count as resting contact, not a bounce
+const float REST_SPEED = 0.05f;
+
+// Rows in the headless ball-count growth table
+const int GROWTH_SAMPLES = 20;
 
 struct Ball {
     float x, y;
@@ -15,11 +41,116 @@ struct Ball {
     float r, g, b;
 };
 
-// Global list of balls
-std::vector<Ball> balls;
+// Fixed-capacity ball storage. The whole pool is reserved and touched up front
+// (huge-page-backed where the OS allows it), so spawning a ball never allocates
+// and existing balls never move.
+struct BallPool {
+    Ball *data = nullptr;
+    size_t count = 0;
+    size_t capacity = 0;
+    size_t bytes = 0;
+    bool mapped = false;
+    bool hugePages = false;
+
+    bool reserve(size_t maxBalls) {
+        const size_t hugePageSize = 2 * 1024 * 1024;
+        // Rounding up to a whole huge page must not wrap size_t
+        if (maxBalls > (SIZE_MAX - hugePageSize) / sizeof(Ball)) return false;
+        bytes = (maxBalls * sizeof(Ball) + hugePageSize - 1) / hugePageSize * hugePageSize;
+
+#ifdef __linux__
+        // Explicit huge pages first, then transparent huge pages on a normal mapping
+        void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED) {
+            hugePages = true;
+        } else {
+            mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED) return false;
+#ifdef MADV_HUGEPAGE
+            hugePages = madvise(mem, bytes, MADV_HUGEPAGE) == 0;
+#endif
+        }
+        data = static_cast<Ball *>(mem);
+        mapped = true;
+#else
+        data = static_cast<Ball *>(::operator new(bytes, std::align_val_t(64), std::nothrow));
+        if (!data) return false;
+#endif
+
+        // Fault every page in now instead of in the middle of a frame
+        memset(data, 0, bytes);
+        capacity = maxBalls;
+        count = 0;
+        return true;
+    }
+
+    void release() {
+        if (!data) return;
+#ifdef __linux__
+        if (mapped) munmap(data, bytes);
+#else
+        ::operator delete(data, std::align_val_t(64));
+#endif
+        data = nullptr;
+        count = capacity = bytes = 0;
+    }
+
+    // Returns a slot for a new ball, or nullptr when the cap is reached
+    Ball *spawn() { return count < capacity ? &data[count++] : nullptr; }
+};
+
+// Global ball storage
+BallPool balls;
+
+// Physical model, all in world units (the view spans -1..1) and seconds
+struct SimConfig {
+    float tickRate = 120.0f;   // Fixed simulation ticks per second
+    float gravity = 0.0f;      // Downward acceleration, units/s^2
+    float restitution = 1.0f;  // Fraction of normal speed kept on a wall hit
+    float drag = 0.0f;         // Linear drag coefficient, 1/s
+    float spawnSpeed = 0.9f;   // Max speed per axis of a spawned ball, units/s
+};
+
+SimConfig sim;
+
+// Bounce sounds, fed from stepBalls()
+BounceMixer mixer;
+
+// Parse a positive count (balls, steps), returns 0 on malformed input. strtoull would
+// quietly wrap a leading '-' around to a huge count, so only digits are accepted.
+size_t parseBallCount(const char *text) {
+    if (!text || !isdigit(static_cast<unsigned char>(*text))) return 0;
+    errno = 0;
+    char *end = nullptr;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value > SIZE_MAX) return 0;
+    return static_cast<size_t>(value);
+}
+
+// Parse a --seed value: a decimal number that fits in 32 bits. Zero is a valid seed.
+bool parseSeed(const char *text, uint32_t &out) {
+    if (!text || !isdigit(static_cast<unsigned char>(*text))) return false;
+    errno = 0;
+    char *end = nullptr;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value > UINT32_MAX) return false;
+    out = static_cast<uint32_t>(value);
+    return true;
+}
+
+// Sim random state. xorshift32 instead of rand(): no libc lock in the bounce path,
+// and a given --seed replays the same run on every platform.
+uint32_t rngState = 1;
+
+void seedRandom(uint32_t seed) { rngState = seed ? seed : 0x9E3779B9u; }
 
 // Generate a random float between min and max
-float randFloat(float min, float max) { return min + ((float)rand() / (float)(RAND_MAX)) * (max - min); }
+float randFloat(float min, float max) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return min + (rngState >> 8) * (1.0f / 16777216.0f) * (max - min);
+}
 
 // Change the color of a ball randomly
 void randomizeColor(Ball &b) {
@@ -28,34 +159,285 @@ void randomizeColor(Ball &b) {
     b.b = randFloat(0.2f, 1.0f);
 }
 
-// Draw the ball with a border
-void drawBall(const Ball &b) {
-    const int segments = 64;
+// Reflect one velocity component off a wall. Returns true if the hit counts as a bounce. Only a sim that
+// settles zeroes slow hits; the lossless default bounces at any speed, like the original.
+bool reflect(float &v, float restitution, bool settles) {
+    if (settles && std::fabs(v) <= REST_SPEED) {
+        v = 0.0f;
+        return false;
+    }
+    v = -v * restitution;
+    return true;
+}
+
+// Advance every live ball by one fixed tick with semi-implicit Euler:
+// velocity is updated from forces first, then position from the new velocity.
+// Returns the number of bounces in the tick.
+size_t stepBalls(float dt) {
+    const float dvy = -sim.gravity * dt;
+    const float damping = std::exp(-sim.drag * dt);
+    const bool settles = sim.gravity > 0.0f || sim.restitution < 1.0f;
+
+    // Balls spawned this tick start moving next tick
+    const size_t live = balls.count;
+    size_t bounces = 0;
+
+    for (size_t i = 0; i < live; ++i) {
+        Ball &b = balls.data[i];
+        b.vx = b.vx * damping;
+        b.vy = (b.vy + dvy) * damping;
+        b.x += b.vx * dt;
+        b.y += b.vy * dt;
+
+        bool bounced = false;
+
+        // Check collisions with window borders
+        if (b.x + b.radius > 1.0f) {
+            b.x = 1.0f - b.radius;
+            bounced |= reflect(b.vx, sim.restitution, settles);
+        } else if (b.x - b.radius < -1.0f) {
+            b.x = -1.0f + b.radius;
+            bounced |= reflect(b.vx, sim.restitution, settles);
+        }
+
+        if (b.y + b.radius > 1.0f) {
+            b.y = 1.0f - b.radius;
+            bounced |= reflect(b.vy, sim.restitution, settles);
+        } else if (b.y - b.radius < -1.0f) {
+            b.y = -1.0f + b.radius;
+            bounced |= reflect(b.vy, sim.restitution, settles);
+        }
+
+        // If a bounce occurred:
+        if (bounced) {
+            randomizeColor(b); // change ball color
+            mixer.noteBounce(b.x);
+            bounces++;
+
+            // If ball count is within limit, create a new ball
+            if (Ball *newBall = balls.spawn()) {
+                newBall->x = b.x;
+                newBall->y = b.y;
+                newBall->radius = b.radius;
+                newBall->vx = randFloat(-sim.spawnSpeed, sim.spawnSpeed);
+                newBall->vy = randFloat(-sim.spawnSpeed, sim.spawnSpeed);
+                randomizeColor(*newBall);
+            }
+        }
+    }
+    return bounces;
+}
+
+// Parse a float option value, returns false on malformed input
+bool parseFloat(const char *text, float &out) {
+    char *end = nullptr;
+    float value = strtof(text, &end);
+    if (end == text || *end != '\0') return false;
+    out = value;
+    return true;
+}
+
+#ifdef BALL_HEADLESS
+// Run a fixed number of ticks as fast as possible and report throughput.
+// Nothing is printed until the loop is done.
+void runBenchmark(size_t steps, uint32_t seed) {
+    const float dt = 1.0f / sim.tickRate;
+    const size_t sampleEvery = steps >= GROWTH_SAMPLES ? steps / GROWTH_SAMPLES : 1;
+
+    std::vector<size_t> growthStep, growthBalls;
+    growthStep.reserve(GROWTH_SAMPLES + 2);
+    growthBalls.reserve(GROWTH_SAMPLES + 2);
+    size_t capStep = 0;
+    size_t totalBounces = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t step = 0; step < steps; ++step) {
+        if (step % sampleEvery == 0) {
+            growthStep.push_back(step);
+            growthBalls.push_back(balls.count);
+        }
+        totalBounces += stepBalls(dt);
+        if (capStep == 0 && balls.count == balls.capacity) capStep = step + 1;
+        mixer.flushBounces();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    growthStep.push_back(steps);
+    growthBalls.push_back(balls.count);
+
+    std::cout << "seed:          " << seed << "\n";
+    std::cout << "steps:         " << steps << " (dt " << dt << " s)\n";
+    std::cout << "final balls:   " << balls.count << " / " << balls.capacity << "\n";
+    if (capStep) std::cout << "cap reached:   step " << capStep << "\n";
+    std::cout << "time:          " << seconds << " s\n";
+    std::cout << "steps/sec:     " << (seconds > 0.0 ? steps / seconds : 0.0) << "\n";
+    std::cout << "bounces/step:  " << (steps ? double(totalBounces) / steps : 0.0) << "\n";
+    std::cout << "\nstep\tballs\n";
+    for (size_t i = 0; i < growthStep.size(); ++i) std::cout << growthStep[i] << "\t" << growthBalls[i] << "\n";
+}
+#else
+// Border thickness around every ball, in world units
+const float BORDER = 0.005f;
+
+// Unit-circle triangle fans at increasing detail, all in one VBO, built once at startup
+const int LOD_COUNT = 5;
+const int LOD_SEGMENTS[LOD_COUNT] = {8, 16, 32, 64, 128};
+
+struct CircleMesh {
+    GLuint vbo = 0;
+    GLint first[LOD_COUNT];
+    GLsizei count[LOD_COUNT];
+};
+
+CircleMesh circle;
+
+void buildCircleMesh() {
+    std::vector<float> vertices;
+    for (int lod = 0; lod < LOD_COUNT; ++lod) {
+        const int segments = LOD_SEGMENTS[lod];
+        circle.first[lod] = static_cast<GLint>(vertices.size() / 2);
+        circle.count[lod] = segments + 2; // Center plus a closed rim
+
+        vertices.push_back(0.0f);
+        vertices.push_back(0.0f);
+        for (int i = 0; i <= segments; ++i) {
+            float angle = i * 2.0f * M_PI / segments;
+            vertices.push_back(cos(angle));
+            vertices.push_back(sin(angle));
+        }
+    }
+
+    glGenBuffers(1, &circle.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, circle.vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+}
+
+// Screen-space LOD: fewest segments that keep the polygon within half a pixel of the true circle.
+// Chord error of an n-gon is about r * pi^2 / (2 n^2).
+int pickLod(float pixelRadius) {
+    const float maxError = 0.5f;
+    for (int lod = 0; lod < LOD_COUNT; ++lod) {
+        float n = static_cast<float>(LOD_SEGMENTS[lod]);
+        if (pixelRadius * M_PI * M_PI / (2.0f * n * n) <= maxError) return lod;
+    }
+    return LOD_COUNT - 1;
+}
+
+// Draw the ball with a border: the cached unit circle scaled and moved into place
+void drawBall(const Ball &b, float pixelsPerUnit) {
+    const float outer = b.radius + BORDER;
+    const int lod = pickLod(outer * pixelsPerUnit);
+
+    glLoadIdentity();
+    glTranslatef(b.x, b.y, 0.0f);
 
     // Border (black circle slightly larger than ball)
+    glScalef(outer, outer, 1.0f);
     glColor3f(0.0f, 0.0f, 0.0f);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(b.x, b.y);
-    for (int i = 0; i <= segments; ++i) {
-        float angle = i * 2.0f * M_PI / segments;
-        glVertex2f(b.x + (b.radius + 0.005f) * cos(angle), b.y + (b.radius + 0.005f) * sin(angle));
-    }
-    glEnd();
+    glDrawArrays(GL_TRIANGLE_FAN, circle.first[lod], circle.count[lod]);
 
     // Fill (colored circle)
+    const float inner = b.radius / outer;
+    glScalef(inner, inner, 1.0f);
     glColor3f(b.r, b.g, b.b);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex2f(b.x, b.y);
-    for (int i = 0; i <= segments; ++i) {
-        float angle = i * 2.0f * M_PI / segments;
-        glVertex2f(b.x + b.radius * cos(angle), b.y + b.radius * sin(angle));
-    }
-    glEnd();
+    glDrawArrays(GL_TRIANGLE_FAN, circle.first[lod], circle.count[lod]);
 }
+#endif
+
+int main(int argc, char **argv) {
+    uint32_t seed = static_cast<uint32_t>(time(nullptr));
+#ifdef BALL_HEADLESS
+    size_t steps = 10000;
+#endif
+
+#if defined(BALL_AUDIO_ALSA) && !defined(BALL_HEADLESS)
+    std::string audioMode = "alsa";
+#else
+    std::string audioMode = "off";
+#endif
+    std::string soundPath = "sounds/b.wav";
+
+    // Ball cap: command line beats environment beats default
+    size_t maxBalls = DEFAULT_MAX_BALLS;
+    if (const char *env = getenv("BALL_MAX_BALLS")) {
+        maxBalls = parseBallCount(env);
+        if (maxBalls == 0) {
+            std::cerr << "Invalid BALL_MAX_BALLS value\n";
+            return -1;
+        }
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--max-balls") == 0 && i + 1 < argc) {
+            maxBalls = parseBallCount(argv[++i]);
+            if (maxBalls == 0) {
+                std::cerr << "Invalid --max-balls value\n";
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            if (!parseSeed(argv[++i], seed)) {
+                std::cerr << "Invalid --seed value\n";
+                return -1;
+            }
+#ifdef BALL_HEADLESS
+        } else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+            steps = parseBallCount(argv[++i]);
+            if (steps == 0) {
+                std::cerr << "Invalid --steps value\n";
+                return -1;
+            }
+#endif
+        } else if (strcmp(argv[i], "--audio") == 0 && i + 1 < argc) {
+            audioMode = argv[++i];
+        } else if (strcmp(argv[i], "--sound") == 0 && i + 1 < argc) {
+            soundPath = argv[++i];
+        } else if (i + 1 < argc && (strcmp(argv[i], "--tick-rate") == 0 || strcmp(argv[i], "--gravity") == 0 ||
+                                    strcmp(argv[i], "--restitution") == 0 || strcmp(argv[i], "--drag") == 0)) {
+            const char *name = argv[i];
+            float *target = strcmp(name, "--tick-rate") == 0     ? &sim.tickRate
+                            : strcmp(name, "--gravity") == 0     ? &sim.gravity
+                            : strcmp(name, "--restitution") == 0 ? &sim.restitution
+                                                                 : &sim.drag;
+            if (!parseFloat(argv[++i], *target)) {
+                std::cerr << "Invalid " << name << " value\n";
+                return -1;
+            }
+        }
+    }
+    if (sim.tickRate <= 0.0f || sim.restitution < 0.0f || sim.drag < 0.0f) {
+        std::cerr << "Tick rate must be positive, restitution and drag non-negative\n";
+        return -1;
+    }
 
-int main() {
-    srand(static_cast<unsigned int>(time(nullptr)));
+    if (!balls.reserve(maxBalls)) {
+        std::cerr << "Failed to reserve storage for " << maxBalls << " balls\n";
+        return -1;
+    }
+    std::cout << "Ball pool: " << maxBalls << " balls, " << balls.bytes / (1024 * 1024) << " MiB"
+              << (balls.hugePages ? " (huge pages)" : "") << "\n";
+
+    // Audio is optional: any failure here just means a silent run
+    Sample bounceSound;
+    NullSink nullSink;
+    WavFileSink fileSink(audioMode);
+#ifdef BALL_AUDIO_ALSA
+    AlsaSink alsaSink;
+#endif
+    if (audioMode != "off") {
+        AudioSink *sink = audioMode == "null" ? static_cast<AudioSink *>(&nullSink) : &fileSink;
+#ifdef BALL_AUDIO_ALSA
+        if (audioMode == "alsa") sink = &alsaSink;
+#endif
+        if (!loadWav(soundPath, bounceSound) || !mixer.start(&bounceSound, sink))
+            std::cerr << "Audio disabled (could not start " << audioMode << " with " << soundPath << ")\n";
+    }
+
+    seedRandom(seed);
 
+    // Add the first ball
+    *balls.spawn() = {0.0f, 0.0f, 0.6f, 0.42f, 0.05f, 1.0f, 0.0f, 0.0f};
+
+#ifdef BALL_HEADLESS
+    runBenchmark(steps, seed);
+#else
     if (!glfwInit()) return -1;
     GLFWwindow *window = glfwCreateWindow(800, 600, "Ball Bounce", nullptr, nullptr);
     if (!window) {
@@ -71,70 +453,48 @@ int main() {
     glOrtho(-1, 1, -1, 1, -1, 1);
     glMatrixMode(GL_MODELVIEW);
 
-    // Add the first ball
-    balls.push_back({0.0f, 0.0f, 0.01f, 0.007f, 0.05f, 1.0f, 0.0f, 0.0f});
+    // Every ball draws from the same cached circle VBO
+    buildCircleMesh();
+    glBindBuffer(GL_ARRAY_BUFFER, circle.vbo);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, nullptr);
+
+    const double dt = 1.0 / sim.tickRate;
+    double accumulator = 0.0;
+    double previousTime = glfwGetTime();
 
     while (!glfwWindowShouldClose(window)) {
         glClear(GL_COLOR_BUFFER_BIT);
 
-        std::vector<Ball> newBalls;
-
-        for (Ball &b : balls) {
-            b.x += b.vx;
-            b.y += b.vy;
-
-            bool bounced = false;
-
-            // Check collisions with window borders
-            if (b.x + b.radius > 1.0f) {
-                b.x = 1.0f - b.radius;
-                b.vx *= -1;
-                bounced = true;
-            } else if (b.x - b.radius < -1.0f) {
-                b.x = -1.0f + b.radius;
-                b.vx *= -1;
-                bounced = true;
-            }
-
-            if (b.y + b.radius > 1.0f) {
-                b.y = 1.0f - b.radius;
-                b.vy *= -1;
-                bounced = true;
-            } else if (b.y - b.radius < -1.0f) {
-                b.y = -1.0f + b.radius;
-                b.vy *= -1;
-                bounced = true;
-            }
+        // Run as many fixed ticks as real time demands, then draw once
+        double now = glfwGetTime();
+        accumulator += now - previousTime;
+        previousTime = now;
 
-            // If a bounce occurred:
-            if (bounced) {
-                randomizeColor(b); // change ball color
-                fflush(stdout);
-
-                // If ball count is within limit, create a new ball
-                if (balls.size() + newBalls.size() < MAX_BALLS) {
-                    Ball newBall;
-                    newBall.x = b.x;
-                    newBall.y = b.y;
-                    newBall.radius = b.radius;
-                    newBall.vx = randFloat(-0.015f, 0.015f);
-                    newBall.vy = randFloat(-0.015f, 0.015f);
-                    randomizeColor(newBall);
-                    newBalls.push_back(newBall);
-                }
-            }
-
-            glLoadIdentity();
-            drawBall(b);
+        int ticks = 0;
+        while (accumulator >= dt && ticks < MAX_TICKS_PER_FRAME) {
+            stepBalls(static_cast<float>(dt));
+            accumulator -= dt;
+            ++ticks;
         }
+        if (accumulator >= dt) accumulator = 0.0; // Too slow to catch up, drop the backlog
+        mixer.flushBounces();
+
+        // The view spans 2 units, so half the larger framebuffer side is one unit on screen
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        const float pixelsPerUnit = 0.5f * (width > height ? width : height);
 
-        // Add new balls to the main list
-        balls.insert(balls.end(), newBalls.begin(), newBalls.end());
+        for (size_t i = 0; i < balls.count; ++i) drawBall(balls.data[i], pixelsPerUnit);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    glDeleteBuffers(1, &circle.vbo);
     glfwTerminate();
+#endif
+    mixer.stop();
+    balls.release();
     return 0;
 }
@@ -0,0 +1,288 @@
+#include "mixer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef BALL_AUDIO_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+// Little-endian field readers for the WAV parser
+static uint16_t readU16(const unsigned char *p) { return uint16_t(p[0] | (p[1] << 8)); }
+static uint32_t readU32(const unsigned char *p) { return uint32_t(p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24)); }
+
+bool loadWav(const std::string &path, Sample &out) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    std::vector<unsigned char> bytes;
+    unsigned char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) bytes.insert(bytes.end(), buffer, buffer + n);
+    fclose(f);
+
+    if (bytes.size() < 12 || memcmp(bytes.data(), "RIFF", 4) != 0 || memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+        std::cerr << path << ": not a WAV file\n";
+        return false;
+    }
+
+    // Walk the chunk list; fmt and data may be separated by LIST or other chunks
+    int channels = 0, bits = 0, rate = 0;
+    const unsigned char *data = nullptr;
+    size_t dataSize = 0;
+    size_t pos = 12;
+    while (pos + 8 <= bytes.size()) {
+        const unsigned char *chunk = bytes.data() + pos;
+        size_t size = readU32(chunk + 4);
+        if (pos + 8 + size > bytes.size()) size = bytes.size() - pos - 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            if (readU16(chunk + 8) != 1) {
+                std::cerr << path << ": only PCM WAV files are supported\n";
+                return false;
+            }
+            channels = readU16(chunk + 10);
+            rate = int(readU32(chunk + 12));
+            bits = readU16(chunk + 22);
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            data = chunk + 8;
+            dataSize = size;
+        }
+        pos += 8 + size + (size & 1);
+    }
+
+    if (!data || bits != 16 || (channels != 1 && channels != 2)) {
+        std::cerr << path << ": expected 16-bit mono or stereo PCM\n";
+        return false;
+    }
+
+    out.sampleRate = rate;
+    out.frameCount = dataSize / (2 * channels);
+    out.frames.resize(out.frameCount * 2);
+    for (size_t i = 0; i < out.frameCount; ++i) {
+        const unsigned char *frame = data + i * 2 * channels;
+        float left = int16_t(readU16(frame)) / 32768.0f;
+        float right = channels == 2 ? int16_t(readU16(frame + 2)) / 32768.0f : left;
+        out.frames[i * 2] = left;
+        out.frames[i * 2 + 1] = right;
+    }
+    return true;
+}
+
+// ---- WAV file sink ----
+
+static void writeU16(FILE *f, uint16_t v) {
+    unsigned char b[2] = {uint8_t(v), uint8_t(v >> 8)};
+    fwrite(b, 1, 2, f);
+}
+
+static void writeU32(FILE *f, uint32_t v) {
+    unsigned char b[4] = {uint8_t(v), uint8_t(v >> 8), uint8_t(v >> 16), uint8_t(v >> 24)};
+    fwrite(b, 1, 4, f);
+}
+
+bool WavFileSink::open(int sampleRate) {
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Cannot open " << path << " for writing\n";
+        return false;
+    }
+    rate = sampleRate;
+    dataBytes = 0;
+
+    // Header with placeholder sizes, patched in close()
+    fwrite("RIFF", 1, 4, file);
+    writeU32(file, 0);
+    fwrite("WAVEfmt ", 1, 8, file);
+    writeU32(file, 16);
+    writeU16(file, 1);            // PCM
+    writeU16(file, 2);            // Stereo
+    writeU32(file, rate);         // Sample rate
+    writeU32(file, rate * 2 * 2); // Byte rate
+    writeU16(file, 2 * 2);        // Block align
+    writeU16(file, 16);           // Bits per sample
+    fwrite("data", 1, 4, file);
+    writeU32(file, 0);
+    return true;
+}
+
+void WavFileSink::write(const int16_t *frames, size_t frameCount) {
+    if (!file) return;
+    // WAV is little-endian, which matches every platform this demo targets
+    dataBytes += fwrite(frames, sizeof(int16_t) * 2, frameCount, file) * sizeof(int16_t) * 2;
+}
+
+void WavFileSink::close() {
+    if (!file) return;
+    fseek(file, 4, SEEK_SET);
+    writeU32(file, uint32_t(36 + dataBytes));
+    fseek(file, 40, SEEK_SET);
+    writeU32(file, uint32_t(dataBytes));
+    fclose(file);
+    file = nullptr;
+}
+
+// ---- ALSA sink ----
+
+#ifdef BALL_AUDIO_ALSA
+bool AlsaSink::open(int sampleRate) {
+    snd_pcm_t *handle = nullptr;
+    if (snd_pcm_open(&handle, "default", SND_PCM_STREAM_PLAYBACK, 0) < 0) {
+        std::cerr << "ALSA: cannot open default device\n";
+        return false;
+    }
+    // 20 ms device latency keeps bounces feeling attached to the visuals
+    if (snd_pcm_set_params(handle, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED, 2, sampleRate, 1, 20000) < 0) {
+        std::cerr << "ALSA: unsupported stream parameters\n";
+        snd_pcm_close(handle);
+        return false;
+    }
+    pcm = handle;
+    return true;
+}
+
+void AlsaSink::write(const int16_t *frames, size_t frameCount) {
+    if (!pcm) return;
+    snd_pcm_sframes_t written = snd_pcm_writei(pcm, frames, frameCount);
+    if (written < 0) snd_pcm_recover(pcm, int(written), 1); // Underrun, drop the block and keep going
+}
+
+void AlsaSink::close() {
+    if (!pcm) return;
+    snd_pcm_drain(pcm);
+    snd_pcm_close(pcm);
+    pcm = nullptr;
+}
+#endif
+
+// ---- Mixer ----
+
+bool BounceMixer::start(const Sample *s, AudioSink *out) {
+    if (!s || s->frameCount == 0 || !out || !out->open(s->sampleRate)) return false;
+    sample = s;
+    sink = out;
+    for (Voice &v : voices) v.active = false;
+    running.store(true, std::memory_order_release);
+    thread = std::thread(&BounceMixer::run, this);
+    return true;
+}
+
+void BounceMixer::stop() {
+    if (!running.exchange(false)) return;
+    thread.join();
+    sink->close();
+}
+
+void BounceMixer::flushBounces() {
+    if (pendingCount == 0) return;
+    if (!running.load(std::memory_order_relaxed)) {
+        pendingCount = 0;
+        pendingPanSum = 0.0f;
+        return;
+    }
+    BounceEvent event = {pendingCount, pendingPanSum / pendingCount};
+    if (!events.push(event)) dropped.fetch_add(1, std::memory_order_relaxed);
+    pendingCount = 0;
+    pendingPanSum = 0.0f;
+}
+
+void BounceMixer::trigger(const BounceEvent &event) {
+    // Loudness grows with the log of the bounce count so a thousand bounces sound busy, not deafening
+    float loudness = std::min(1.0f, 0.25f + 0.1f * std::log2(float(event.count)));
+    float angle = (std::max(-1.0f, std::min(1.0f, event.pan)) + 1.0f) * 0.25f * float(M_PI); // Equal-power pan
+
+    // Free voice first, otherwise steal the one furthest into its tail
+    Voice *target = nullptr;
+    for (Voice &v : voices) {
+        if (!v.active) {
+            target = &v;
+            break;
+        }
+        if (!target || v.position > target->position) target = &v;
+    }
+    if (target->active) stolen.fetch_add(1, std::memory_order_relaxed);
+
+    target->position = 0;
+    target->gainL = loudness * std::cos(angle);
+    target->gainR = loudness * std::sin(angle);
+    target->active = true;
+}
+
+void BounceMixer::mixBlock(float *out, size_t frameCount) {
+    memset(out, 0, frameCount * 2 * sizeof(float));
+
+    for (Voice &v : voices) {
+        if (!v.active) continue;
+        size_t n = std::min(frameCount, sample->frameCount - v.position);
+        const float *src = sample->frames.data() + v.position * 2;
+        size_t i = 0;
+#ifdef __SSE2__
+        // Two stereo frames per iteration
+        const __m128 gain = _mm_setr_ps(v.gainL, v.gainR, v.gainL, v.gainR);
+        for (; i + 2 <= n; i += 2) {
+            __m128 acc = _mm_loadu_ps(out + i * 2);
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(src + i * 2), gain));
+            _mm_storeu_ps(out + i * 2, acc);
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i * 2] += src[i * 2] * v.gainL;
+            out[i * 2 + 1] += src[i * 2 + 1] * v.gainR;
+        }
+        v.position += n;
+        if (v.position >= sample->frameCount) v.active = false;
+    }
+}
+
+// Float to 16-bit with saturation
+static void toPcm16(const float *in, int16_t *out, size_t sampleCount) {
+    size_t i = 0;
+#ifdef __SSE2__
+    // Vector loop over whole groups of eight, so the scalar tail below provably runs under eight times
+    const size_t vectorEnd = sampleCount - sampleCount % 8;
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    for (; i < vectorEnd; i += 8) {
+        __m128i lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i), scale));
+        __m128i hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi32(lo, hi));
+    }
+#endif
+    for (; i < sampleCount; ++i) {
+        float s = std::max(-1.0f, std::min(1.0f, in[i]));
+        out[i] = int16_t(std::lrint(s * 32767.0f));
+    }
+}
+
+void BounceMixer::run() {
+    float mix[BLOCK_FRAMES * 2];
+    int16_t pcm[BLOCK_FRAMES * 2];
+
+    const auto blockTime = std::chrono::nanoseconds(1000000000LL * BLOCK_FRAMES / sample->sampleRate);
+    auto deadline = std::chrono::steady_clock::now();
+
+    while (running.load(std::memory_order_acquire)) {
+        // Everything that arrived since the last block starts together as one voice
+        BounceEvent event, merged = {0, 0.0f};
+        while (events.pop(event)) {
+            merged.pan = (merged.pan * merged.count + event.pan * event.count) / (merged.count + event.count);
+            merged.count += event.count;
+        }
+        if (merged.count > 0) trigger(merged);
+
+        mixBlock(mix, BLOCK_FRAMES);
+        toPcm16(mix, pcm, BLOCK_FRAMES * 2);
+        sink->write(pcm, BLOCK_FRAMES);
+
+        // Device sinks pace us by blocking; null and file sinks are paced by the clock
+        if (!sink->paced()) {
+            deadline += blockTime;
+            std::this_thread::sleep_until(deadline);
+        }
+    }
+}
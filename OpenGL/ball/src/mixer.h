@@ -0,0 +1,158 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Single-producer single-consumer ring buffer. The sim thread pushes, the audio thread pops.
+// Neither side ever blocks or allocates; a full queue drops the item.
+template <typename T, size_t Capacity> class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+  public:
+    bool push(const T &item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == Capacity) return false;
+        items_[head & (Capacity - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;
+        item = items_[tail & (Capacity - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+  private:
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) T items_[Capacity];
+};
+
+// All bounces of one frame folded into a single trigger
+struct BounceEvent {
+    uint32_t count; // Bounces in the frame
+    float pan;      // Average bounce x position, -1 (left) .. 1 (right)
+};
+
+// A decoded sound: interleaved stereo float frames
+struct Sample {
+    std::vector<float> frames; // L, R, L, R ...
+    size_t frameCount = 0;
+    int sampleRate = 0;
+};
+
+// Load a 16-bit PCM mono or stereo WAV file into a stereo float sample
+bool loadWav(const std::string &path, Sample &out);
+
+// Where mixed audio goes: a device, a file, or nowhere
+class AudioSink {
+  public:
+    virtual ~AudioSink() {}
+    virtual bool open(int sampleRate) = 0;
+    virtual void write(const int16_t *frames, size_t frameCount) = 0; // Interleaved stereo
+    virtual void close() {}
+    virtual bool paced() const { return false; } // True if write() blocks at the device rate
+};
+
+// Discards audio, only counts it
+class NullSink : public AudioSink {
+  public:
+    bool open(int) override { return true; }
+    void write(const int16_t *, size_t frameCount) override { framesWritten += frameCount; }
+
+    size_t framesWritten = 0;
+};
+
+// Writes a 16-bit stereo WAV file
+class WavFileSink : public AudioSink {
+  public:
+    explicit WavFileSink(const std::string &path) : path(path) {}
+    ~WavFileSink() override { close(); }
+
+    bool open(int sampleRate) override;
+    void write(const int16_t *frames, size_t frameCount) override;
+    void close() override;
+
+  private:
+    std::string path;
+    FILE *file = nullptr;
+    int rate = 0;
+    size_t dataBytes = 0;
+};
+
+#ifdef BALL_AUDIO_ALSA
+// Plays through the default ALSA device
+class AlsaSink : public AudioSink {
+  public:
+    ~AlsaSink() override { close(); }
+
+    bool open(int sampleRate) override;
+    void write(const int16_t *frames, size_t frameCount) override;
+    void close() override;
+    bool paced() const override { return true; }
+
+  private:
+    struct _snd_pcm *pcm = nullptr;
+};
+#endif
+
+// Fixed-voice sample mixer running on its own thread.
+// The sim thread calls noteBounce() per bounce and flushBounces() once per frame;
+// everything else happens on the audio thread.
+class BounceMixer {
+  public:
+    static const int MAX_VOICES = 32;
+    static const size_t BLOCK_FRAMES = 256;
+
+    ~BounceMixer() { stop(); }
+
+    bool start(const Sample *sample, AudioSink *sink);
+    void stop();
+
+    // Sim thread side, plain accumulation, no atomics
+    void noteBounce(float x) {
+        pendingCount++;
+        pendingPanSum += x;
+    }
+    void flushBounces();
+
+    // Stats, safe to read from any thread
+    size_t droppedEvents() const { return dropped.load(std::memory_order_relaxed); }
+    size_t stolenVoices() const { return stolen.load(std::memory_order_relaxed); }
+
+  private:
+    struct Voice {
+        size_t position; // Next frame of the sample to play
+        float gainL, gainR;
+        bool active;
+    };
+
+    void run();
+    void trigger(const BounceEvent &event);
+    void mixBlock(float *out, size_t frameCount);
+
+    const Sample *sample = nullptr;
+    AudioSink *sink = nullptr;
+    std::thread thread;
+    std::atomic<bool> running{false};
+
+    SpscQueue<BounceEvent, 256> events;
+    Voice voices[MAX_VOICES] = {};
+
+    uint32_t pendingCount = 0;
+    float pendingPanSum = 0.0f;
+
+    std::atomic<size_t> dropped{0};
+    std::atomic<size_t> stolen{0};
+};
+
+#endif